@@ -16,9 +16,19 @@
 #define LED_BLINK_US 500000
 #define BUTTON_DEBOUNCE_MS 20
 #define SLOT_OFFSET_STEPS 144
-#define HALF_STEPS 512
+#define HALF_STEPS 512            // nominal slot pitch, the real one comes from steps_per_rev
+#define WHEEL_SLOTS 8             // compartments on the wheel, calibration hole included
 #define RECOVERY_STEPS 50
 
+//irq filters
+#define IRQ_BURST_WINDOW_US 10000
+#define IRQ_STORM_MASK_US   5000
+#define OPTO_MIN_GAP_US     500     // opto fork bounce; index edges are >30 ms apart
+#define OPTO_BURST_MAX      8
+#define PIEZO_MIN_GAP_US    200
+#define PIEZO_BURST_MAX     8
+#define PIEZO_HOLD_OFF_US   20000   // ignore the ringing after an impact
+
 //pill
 #define PILL_TIME 30000
 #define PILL_NUMS 7
@@ -52,11 +62,14 @@ typedef struct Stepper{
     uint sensor_pin;
     int  step_index;
     int  steps_per_rev;
+    uint32_t slot_pitch_q16; // steps_per_rev / WHEEL_SLOTS in 16.16 fixed point
     bool calibrated;
     volatile bool index_hit;
     int  slot_offset_steps;
     //for recovery
     bool in_motion;
+    volatile int position;   // half-steps CW from the index edge, wraps at steps_per_rev
+    int  target;             // where the move in flight ends
 } Stepper;
 
 typedef struct Dispenser{
@@ -0,0 +1,102 @@
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "coil_pwm.h"
+
+// Half-step sequence (LSB -> pins[0])
+static const uint8_t half_steps[8][4] = {
+    {1, 0, 0, 0},
+    {1, 1, 0, 0},
+    {0, 1, 0, 0},
+    {0, 1, 1, 0},
+    {0, 0, 1, 0},
+    {0, 0, 1, 1},
+    {0, 0, 0, 1},
+    {1, 0, 0, 1}
+};
+
+typedef struct {
+    uint  pins[4];
+    uint  slices[4];                       // distinct slices used by the coil pins
+    int   n_slices;
+    uint16_t top;
+    uint8_t  duty[COIL_LEVELS];            // percent
+    uint32_t cc[COIL_LEVELS][8][4];        // CC register word per level, phase, slice
+} coil_t;
+
+static coil_t coil;
+
+static void build_level(coil_level_t level) {
+    uint32_t compare = (uint32_t)(coil.top + 1) * coil.duty[level] / 100;
+    for (int s = 0; s < 8; s++) {
+        for (int k = 0; k < coil.n_slices; k++) {
+            uint32_t word = 0;
+            for (int i = 0; i < 4; i++) {
+                if (half_steps[s][i] && pwm_gpio_to_slice_num(coil.pins[i]) == coil.slices[k]) {
+                    word |= compare << (pwm_gpio_to_channel(coil.pins[i]) == PWM_CHAN_B ? PWM_CH0_CC_B_LSB : 0);
+                }
+            }
+            coil.cc[level][s][k] = word;
+        }
+    }
+}
+
+void coil_init(const uint pins[4]) {
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    coil.top = (uint16_t)(sys_hz / COIL_PWM_FREQ_HZ - 1);
+    coil.n_slices = 0;
+
+    for (int i = 0; i < 4; i++) {
+        coil.pins[i] = pins[i];
+        uint slice = pwm_gpio_to_slice_num(pins[i]);
+        bool seen = false;
+        for (int k = 0; k < coil.n_slices; k++) {
+            seen |= coil.slices[k] == slice;
+        }
+        if (!seen) {
+            coil.slices[coil.n_slices++] = slice;
+            pwm_config c = pwm_get_default_config();
+            pwm_config_set_clkdiv(&c, 1.0f);
+            pwm_config_set_wrap(&c, coil.top);
+            pwm_init(slice, &c, false);
+            pwm_hw->slice[slice].cc = 0;
+        }
+        gpio_set_function(pins[i], GPIO_FUNC_PWM);
+    }
+
+    coil.duty[COIL_HOLD]  = COIL_DUTY_HOLD;
+    coil.duty[COIL_RUN]   = COIL_DUTY_RUN;
+    coil.duty[COIL_BOOST] = COIL_DUTY_BOOST;
+    for (int l = 0; l < COIL_LEVELS; l++) {
+        build_level((coil_level_t)l);
+    }
+
+    // Start all slices together so the coils switch in phase
+    uint32_t mask = 0;
+    for (int k = 0; k < coil.n_slices; k++) {
+        mask |= 1u << coil.slices[k];
+    }
+    pwm_set_mask_enabled(pwm_hw->en | mask);
+}
+
+void coil_set_phase(coil_level_t level, int phase) {
+    const uint32_t *cc = coil.cc[level][phase & 7];
+    for (int k = 0; k < coil.n_slices; k++) {
+        pwm_hw->slice[coil.slices[k]].cc = cc[k];
+    }
+}
+
+void coil_off(void) {
+    for (int k = 0; k < coil.n_slices; k++) {
+        pwm_hw->slice[coil.slices[k]].cc = 0;
+    }
+}
+
+void coil_set_duty(coil_level_t level, uint8_t percent) {
+    if (level >= COIL_LEVELS) {
+        return;
+    }
+    coil.duty[level] = percent > 100 ? 100 : percent;
+    build_level(level);
+}
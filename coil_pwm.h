@@ -0,0 +1,33 @@
+#ifndef PILL_DISPENSER_COIL_PWM_H
+#define PILL_DISPENSER_COIL_PWM_H
+
+#include <stdint.h>
+#include "pico/types.h"
+
+#define COIL_PWM_FREQ_HZ   20000   // above the audible range
+#define COIL_DUTY_HOLD     30      // percent, wheel standing still with a phase locked
+#define COIL_DUTY_RUN      70      // percent, cruising
+#define COIL_DUTY_BOOST    100     // percent, break-away and acceleration
+
+typedef enum {
+    COIL_HOLD,
+    COIL_RUN,
+    COIL_BOOST,
+    COIL_LEVELS
+} coil_level_t;
+
+// PWM coil driver. The four coil pins run on their PWM slices; every
+// half-step phase at every level is precomputed as compare register
+// words, so a phase change is one register write per slice.
+void coil_init(const uint pins[4]);
+
+// Energise half-step phase 0..7 at the given current level
+void coil_set_phase(coil_level_t level, int phase);
+
+// All coils off
+void coil_off(void);
+
+// Change the duty of one level at run time, 0..100 percent
+void coil_set_duty(coil_level_t level, uint8_t percent);
+
+#endif //PILL_DISPENSER_COIL_PWM_H
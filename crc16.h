@@ -0,0 +1,19 @@
+#ifndef PILL_DISPENSER_CRC16_H
+#define PILL_DISPENSER_CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC16_SNIFF_MIN_LEN 32   // below this the DMA setup costs more than the table
+
+// CRC-16/CCITT (poly 0x1021, init 0xFFFF); every backend gives the same result
+typedef enum {
+    CRC16_BITWISE,     // original shift/xor loop, reference
+    CRC16_TABLE,       // 256-entry table in RAM
+    CRC16_DMA_SNIFF    // RP2040 DMA sniffer, table for short buffers
+} crc16_backend_t;
+
+void crc16_init(crc16_backend_t backend);
+uint16_t crc16(const uint8_t *data_p, size_t length);
+
+#endif //PILL_DISPENSER_CRC16_H
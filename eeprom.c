@@ -5,151 +5,452 @@
 #include <pico/stdio.h>
 #include <pico/time.h>
 #include "eeprom.h"
+#include "eeprom_bus.h"
+#include "log_index.h"
 #include "board_config.h"
 #include "hardware/gpio.h"
+#include "hardware/rtc.h"
 void setup_i2c(void) {
     i2c_init(I2C_PORT, I2C_BAUDRATE);
     gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
     gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
     gpio_pull_up(I2C_SDA_PIN);
     gpio_pull_up(I2C_SCL_PIN);
+    eeprom_bus_init();
 }
 
-
-int eeprom_write(uint16_t addr, uint8_t *data, size_t len) {
-    if (len > LOG_ENTRY_SIZE) {
+// Split into page-aligned chunks and stage them in the write-behind queue.
+// Returns before the data is on the chip, so a page the chip later rejects
+// shows up in eeprom_flush() and eeprom_write_failures(), not here.
+// *ticket gets the bus ticket of the last page (may be NULL).
+static int write_pages(uint16_t addr, const uint8_t *data, size_t len, uint32_t *ticket) {
+    if ((uint32_t)addr + len > EEPROM_TOTAL_BYTES) {
         return -1;
     }
-    uint8_t tx[2 + len];
-    tx[0] = (uint8_t)(addr >> 8);
-    tx[1] = (uint8_t)addr & 0xFF;
-    for (int i = 0; i < len; i++) {
-        tx[2 + i] = data[i];
-    }
-    int write=i2c_write_blocking(I2C_PORT, EEPROM_I2C_ADDR,
-                              tx, 2 + len, false);
-    if (write !=2+len) {
-        return -1; //error
+    while (len > 0) {
+        size_t chunk = EEPROM_PAGE_SIZE - (addr % EEPROM_PAGE_SIZE);
+        if (chunk > len) {
+            chunk = len;
+        }
+        if (eeprom_bus_write_page(addr, data, chunk, ticket) != 0) {
+            return -1; //error
+        }
+        addr += chunk;
+        data += chunk;
+        len  -= chunk;
     }
-    sleep_ms(15);
-
     return 0;
 }
+int eeprom_write(uint16_t addr, const uint8_t *data, size_t len) {
+    return write_pages(addr, data, len, NULL);
+}
 int eeprom_read(uint16_t addr, uint8_t *data, size_t len) {
-    if (len > LOG_ENTRY_SIZE) {
-        return -1;
-    }
-    uint8_t tx[2];
-    tx[0] = (uint8_t)(addr >> 8);
-    tx[1] = (uint8_t) (addr& 0xFF);
-
-    i2c_write_blocking(I2C_PORT, EEPROM_I2C_ADDR, tx, 2, true);
-    int read= i2c_read_blocking(I2C_PORT, EEPROM_I2C_ADDR, data, len, false);
-    if (read != (int)len) {
+    return eeprom_bus_read(addr, data, len);
+}
+int eeprom_flush(void) {
+    return eeprom_bus_wait();
+}
+// Write and wait until it is programmed, for core1 and slow paths. A page of
+// the other core failing meanwhile also counts, so the caller may retry
+// something that did reach the chip, but never trusts a lost write.
+int eeprom_write_sync(uint16_t addr, const uint8_t *data, size_t len) {
+    uint32_t failures = eeprom_bus_failures();
+    if (eeprom_write(addr, data, len) != 0 || eeprom_bus_drain() != 0) {
         return -1;
     }
-    return 0;
+    return eeprom_bus_failures() == failures ? 0 : -1;
 }
-uint16_t crc16(const uint8_t *data_p, size_t length) {
-    uint16_t crc = 0xFFFF;
-    while (length--) {
-        uint8_t x = crc >> 8 ^ *data_p++;
-        x ^= x >> 4;
-        crc = (crc << 8) ^ ((uint16_t)(x << 12)) ^((uint16_t)(x << 5))^ ((uint16_t)x);
-    }
-    return crc;
+uint32_t eeprom_write_failures(void) {
+    return eeprom_bus_failures();
+}
+void eeprom_print_stats(void) {
+    printf("[EEPROM] %lu page writes lost\n", (unsigned long)eeprom_bus_failures());
 }
 bool eeprom_available() {
     uint8_t test =0;
     return eeprom_read(EEPROM_STORE_ADDR, &test, 1) ==0;
 }
-int find_log() {
-    uint8_t first_byte;
-    for (int i = 0; i < LOG_MAX_ENTRIES; i++) {
-        uint16_t addr =LOG_START_ADDR +i*LOG_ENTRY_SIZE;
-        if (eeprom_read(addr, &first_byte, 1) !=0) {
+typedef struct {
+    bool     ready;
+    uint32_t next_seq;   // entry seq always lives in slot seq % LOG_MAX_ENTRIES
+} log_pos_t;
+
+static log_pos_t log_pos;
+
+_Static_assert(sizeof(log_record_t) == LOG_ENTRY_SIZE, "log record must fill one slot");
+_Static_assert(EEPROM_PAGE_SIZE % LOG_ENTRY_SIZE == 0, "log records must not straddle pages");
+_Static_assert(LOG_AREA_SIZE % LOG_ENTRY_SIZE == 0, "log partition must hold whole records");
+
+static const char *const log_event_names[LOG_EV_COUNT] = {
+    [LOG_EV_NONE]              = "NONE",
+    [LOG_EV_BOOT_LORA_OK]      = "BOOT DONE LORA OK",
+    [LOG_EV_BOOT_LORA_FAIL]    = "BOOT DONE LORA FAIL",
+    [LOG_EV_FRESH_BOOT]        = "FRESH BOOT",
+    [LOG_EV_POWER_LOSS_MOVING] = "POWER LOSS DURING MOVEMENT",
+    [LOG_EV_NOT_CALIBRATED]    = "MOTOR NOT CALIBRATED",
+    [LOG_EV_RESUME_DISPENSING] = "RESUME DISPENSING",
+    [LOG_EV_CALIBRATION_FAIL]  = "CALIBRATED FAIL",
+    [LOG_EV_CALIBRATION_DONE]  = "CALIBRATION DONE",
+    [LOG_EV_DISPENSING_FINISH] = "DISPENSING FINISH",
+    [LOG_EV_DISPENSE_OK]       = "DISPENSE OK",
+    [LOG_EV_DISPENSE_FAIL]     = "DISPENSE FAIL NO PILLS",
+    [LOG_EV_RECOVERY_DONE]     = "RECOVERY DONE",
+    [LOG_EV_CYCLE_COMPLETE]    = "CYCLE COMPLETE",
+    [LOG_EV_STEP_SLIP]         = "STEP SLIP CORRECTED",
+    [LOG_EV_INDEX_LOST]        = "INDEX LOST RESYNC",
+    [LOG_EV_DISPENSE_MULTI]    = "DISPENSE MULTIPLE PILLS",
+};
+
+// Civil date <-> seconds since 1970 (days_from_civil), valid for 1970..2105
+static uint32_t datetime_to_epoch(const datetime_t *t) {
+    int32_t  y   = t->year - (t->month <= 2);
+    uint32_t m   = (uint32_t)t->month;
+    int32_t  era = y / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + (uint32_t)t->day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    uint32_t days = (uint32_t)(era * 146097 + (int32_t)doe - 719468);
+    return days * 86400u + (uint32_t)t->hour * 3600u + (uint32_t)t->min * 60u + (uint32_t)t->sec;
+}
+
+static void epoch_to_datetime(uint32_t epoch, datetime_t *t) {
+    uint32_t days = epoch / 86400u;
+    uint32_t rem  = epoch % 86400u;
+    uint32_t z    = days + 719468u;
+    uint32_t era  = z / 146097u;
+    uint32_t doe  = z - era * 146097u;
+    uint32_t yoe  = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy  = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp   = (5 * doy + 2) / 153;
+    uint32_t m    = mp < 10 ? mp + 3 : mp - 9;
+    t->year  = (int16_t)(yoe + era * 400 + (m <= 2));
+    t->month = (int8_t)m;
+    t->day   = (int8_t)(doy - (153 * mp + 2) / 5 + 1);
+    t->dotw  = (int8_t)((days + 4) % 7);   // 1970-01-01 was a Thursday
+    t->hour  = (int8_t)(rem / 3600);
+    t->min   = (int8_t)(rem / 60 % 60);
+    t->sec   = (int8_t)(rem % 60);
+}
+
+uint32_t log_next_seq(void) {
+    return log_pos.next_seq;
+}
+
+uint32_t log_time_now(void) {
+    datetime_t t;
+    rtc_get_datetime(&t);
+    return datetime_to_epoch(&t);
+}
+
+// "YYYY-MM-DD HH:MM:SS [Day N ]EVENT", same text the log used to store
+int log_format(const log_record_t *rec, char *buf, size_t len) {
+    datetime_t t;
+    epoch_to_datetime(rec->time, &t);
+    const char *name = rec->event < LOG_EV_COUNT ? log_event_names[rec->event] : "UNKNOWN";
+
+    if (rec->day > 0) {
+        return snprintf(buf, len, "%04d-%02d-%02d %02d:%02d:%02d Day %u %s",
+                        t.year, t.month, t.day, t.hour, t.min, t.sec, rec->day, name);
+    }
+    return snprintf(buf, len, "%04d-%02d-%02d %02d:%02d:%02d %s",
+                    t.year, t.month, t.day, t.hour, t.min, t.sec, name);
+}
+
+// Good crc and stored in the slot its seq maps to
+bool log_record_valid(const log_record_t *rec, uint32_t slot) {
+    return crc16((const uint8_t*)rec, offsetof(log_record_t, crc)) == rec->crc &&
+           rec->seq % LOG_MAX_ENTRIES == slot;
+}
+
+// 1 = valid entry, 0 = empty/corrupt, -1 = EEPROM error
+static int read_entry(int slot, log_record_t *entry) {
+    uint16_t addr = LOG_START_ADDR + slot * LOG_ENTRY_SIZE;
+    if (eeprom_read(addr, (uint8_t*)entry, sizeof(*entry)) != 0) {
+        return -1;
+    }
+    return log_record_valid(entry, (uint32_t)slot);
+}
+
+// Rebuild next_seq once at boot. The log is a ring: slots [0, head) hold the
+// current lap (slot 0 seq + i), slots [head, N) the previous lap or nothing,
+// so the end of the current lap is found by binary search.
+int log_init(void) {
+    log_record_t first;
+    log_record_t entry;
+
+    log_pos.ready = false;
+    int r = read_entry(0, &first);
+    if (r < 0) {
+        return -1;
+    }
+    if (r == 0) {
+        // Empty log, or slot 0 torn while wrapping: continue after the last slot
+        r = read_entry(LOG_MAX_ENTRIES - 1, &entry);
+        if (r < 0) {
             return -1;
         }
-        if (first_byte ==0) {
-            return i; //log empty
-        }
+        log_pos.next_seq = (r == 1) ? entry.seq + 1 : 0;
+        log_pos.ready    = true;
+        log_index_load(log_pos.next_seq);
+        return 0;
     }
 
-    return -1; //full
+    int lo = 1;
+    int hi = LOG_MAX_ENTRIES;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        r = read_entry(mid, &entry);
+        if (r < 0) {
+            return -1;
+        }
+        if (r == 1 && entry.seq == first.seq + (uint32_t)mid) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    log_pos.next_seq = first.seq + lo;
+    log_pos.ready    = true;
+    log_index_load(log_pos.next_seq);
+    printf("[LOG] next seq %lu\n", (unsigned long)log_pos.next_seq);
+    return 0;
 }
 
+// Debug helper only, the ring never needs erasing
 void erase_log() {
-    uint8_t zero =0;
-    for (int i = 0; i < LOG_MAX_ENTRIES; i++) {
-        uint16_t addr = i*LOG_ENTRY_SIZE;
-        eeprom_write(addr,&zero,1);
-        sleep_ms(5);
+    uint8_t zero[EEPROM_PAGE_SIZE] = {0};
+    for (uint32_t addr = 0; addr < LOG_AREA_SIZE; addr += sizeof(zero)) {
+        eeprom_write(LOG_START_ADDR + addr, zero, sizeof(zero));   // breaks every record crc
     }
+    log_pos.next_seq = 0;
+    log_index_load(0);
     printf("Log is erase\n");
 }
 
-void write_log(char *msg) {
-    if (!eeprom_available()) {
+// Constant time: one record write into the slot of the oldest entry.
+// Caller fills time/event/day/...; seq and crc are set here. Runs on core1,
+// so it waits for the record to be programmed: a failed write keeps its seq
+// and the next record takes the slot again.
+void write_log(log_record_t *rec) {
+    static uint32_t failures_seen;   // write-behind losses already reported here
+    if (!log_pos.ready && log_init() != 0) {
         printf("EEPROM not available\n");
         return;
     }
-    int find =find_log();
-    if (find == -1) {
-        printf("Logs are full. Erasing logs\n");
-        erase_log();
-        find =0;
-    }
-    uint16_t addr = LOG_START_ADDR + find * LOG_ENTRY_SIZE;
-    uint8_t entry[LOG_ENTRY_SIZE] = {0};
+    int slot = log_pos.next_seq % LOG_MAX_ENTRIES;
+    uint16_t addr = LOG_START_ADDR + slot * LOG_ENTRY_SIZE;
 
-    snprintf((char*)entry, LOG_ENTRY_SIZE -2, "%s", msg); //61+null
-    int str_len = strlen((char*)entry)+1;
+    rec->seq = log_pos.next_seq;
+    rec->crc = crc16((uint8_t*)rec, offsetof(log_record_t, crc));
 
-    uint16_t check_crc = crc16(entry, str_len);   // include \0
-    entry[str_len ] = (uint8_t)(check_crc >> 8);
-    entry[str_len + 1] = (uint8_t)(check_crc);
+    if (eeprom_write_sync(addr, (uint8_t*)rec, sizeof(*rec)) != 0) {
+        printf("EEPROM WRITE ERROR\n");
+        failures_seen = eeprom_write_failures();
+        return;
+    }
+    // State writes are queued and not waited for, so their losses are only
+    // noticed here, at the next state_flush() and in eeprom_print_stats()
+    uint32_t failures = eeprom_write_failures();
+    if (failures != failures_seen) {
+        printf("[EEPROM] %lu queued page writes lost since the last log record\n",
+               (unsigned long)(failures - failures_seen));
+        failures_seen = failures;
+    }
+    log_pos.next_seq++;
+    log_index_add(rec);
 
-    eeprom_write(addr, entry, LOG_ENTRY_SIZE);
-    printf("Log [%d] %s\n",find+1, msg);
+    char line[LOG_STRING_MAX_LEN];
+    log_format(rec, line, sizeof(line));
+    printf("Log [%lu] %s\n", (unsigned long)rec->seq, line);
 }
-//read command
+//read command, oldest entry first
 void read_log() {
-    if (!eeprom_available()) {
+    if (!log_pos.ready && log_init() != 0) {
         printf("EEPROM not available\n");
         return;
     }
-    uint8_t entry[LOG_ENTRY_SIZE];
-    for (int i = 0; i < LOG_MAX_ENTRIES ; i++) {
-        uint16_t addr = LOG_START_ADDR + i * LOG_ENTRY_SIZE;
-        if (eeprom_read(addr, entry, LOG_ENTRY_SIZE) !=0) {
-            printf("EEPROM READ ERROR\n");
-            return;
+    uint32_t seq = 0;
+    if (log_pos.next_seq > LOG_MAX_ENTRIES) {
+        seq = log_pos.next_seq - LOG_MAX_ENTRIES;
+    }
+    log_record_t rec;
+    char line[LOG_STRING_MAX_LEN];
+    for (; seq < log_pos.next_seq; seq++) {
+        int r = read_entry(seq % LOG_MAX_ENTRIES, &rec);
+        if (r < 0) {
+            printf("Log %lu: EEPROM READ ERROR\n", (unsigned long)seq);
+            continue;   // one bad entry must not end the dump
         }
-        if (entry[0] ==0) {
-            return;
+        if (r == 0 || rec.seq != seq) {
+            continue;   // never written or torn
         }
-        int len = -1;
-        for (int j = 0; j < LOG_STRING_MAX_LEN+1; j++) { //find \0 at idx 62
-            if (entry[j] == 0) {
-                len = j;
-                break;
-            }
+        log_format(&rec, line, sizeof(line));
+        printf("Log %lu: %s\n\n", (unsigned long)rec.seq, line);
+    }
+
+}
+_Static_assert(sizeof(config_record_t) <= EEPROM_PART_CONFIG_SIZE, "config record must fit its partition");
+
+int load_config(config_record_t *cfg) {
+    if (eeprom_read(CONFIG_ADDR, (uint8_t*)cfg, sizeof(*cfg)) != 0) {
+        return -1;
+    }
+    if (cfg->magic != CONFIG_MAGIC ||
+        crc16((uint8_t*)cfg, offsetof(config_record_t, crc)) != cfg->crc) {
+        return -2;
+    }
+    return 0;
+}
+
+int save_config(config_record_t *cfg) {
+    config_record_t old;
+    cfg->magic = CONFIG_MAGIC;
+    cfg->crc   = crc16((uint8_t*)cfg, offsetof(config_record_t, crc));
+    if (load_config(&old) == 0 && memcmp(&old, cfg, sizeof(old)) == 0) {
+        return 0; // already on EEPROM
+    }
+    return eeprom_write_sync(CONFIG_ADDR, (uint8_t*)cfg, sizeof(*cfg));
+}
+
+typedef struct {
+    bool     ready;
+    uint32_t next_seq;   // record seq lives in slot seq % STATS_SLOTS
+    bool     dirty;      // a counter changed since the last save
+    uint32_t count[STAT_COUNT];
+} stats_journal_t;
+
+static stats_journal_t stats;
+
+_Static_assert(sizeof(stats_record_t) <= STATS_SLOT_SIZE, "stats record must fit a journal slot");
+_Static_assert(EEPROM_PART_STATS_SIZE % STATS_SLOT_SIZE == 0, "stats partition must hold whole slots");
+
+static const char *const stat_names[STAT_COUNT] = {
+    [STAT_BOOTS]        = "boots",
+    [STAT_CYCLES]       = "cycles",
+    [STAT_PILLS_OK]     = "pills ok",
+    [STAT_PILLS_FAILED] = "pills failed",
+    [STAT_PILLS_MULTI]  = "multi drops",
+    [STAT_POWER_LOSSES] = "power losses",
+};
+
+// Same journal as the state record: newest good crc wins, a blank chip counts from zero
+int stats_init(void) {
+    stats_record_t rec;
+    bool found = false;
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < STATS_SLOTS; i++) {
+        if (eeprom_read(STATS_ADDR + i * STATS_SLOT_SIZE, (uint8_t*)&rec, sizeof(rec)) != 0) {
+            return -1;
         }
-        if (len ==-1) {
-            printf("Invalid entry at index %d\n", i);
-            return;
+        if (crc16((uint8_t*)&rec, offsetof(stats_record_t, crc)) != rec.crc) {
+            continue;
         }
-        uint16_t stored_crc = (entry[len + 1] << 8) | entry[len + 2];
-        uint16_t calc_crc = crc16(entry, len + 1); // entry+ '\0'
-        if (calc_crc != stored_crc) {
-            printf("CRC ERROR\n");
-            return;
+        if (!found || rec.seq >= stats.next_seq) {
+            found = true;
+            stats.next_seq = rec.seq + 1;
+            memcpy(stats.count, rec.count, sizeof(stats.count));
         }
+    }
+    stats.ready = true;
+    stats_add(STAT_BOOTS);
+    return stats_save();
+}
+
+void stats_add(stat_id_t id) {
+    if (id < STAT_COUNT) {
+        stats.count[id]++;
+        stats.dirty = true;
+    }
+}
+
+uint32_t stats_get(stat_id_t id) {
+    return id < STAT_COUNT ? stats.count[id] : 0;
+}
+
+int stats_save(void) {
+    if (!stats.ready || !stats.dirty) {
+        return 0;
+    }
+    stats_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.seq = stats.next_seq;
+    memcpy(rec.count, stats.count, sizeof(rec.count));
+    rec.crc = crc16((uint8_t*)&rec, offsetof(stats_record_t, crc));
+
+    uint16_t addr = STATS_ADDR + (rec.seq % STATS_SLOTS) * STATS_SLOT_SIZE;
+    if (eeprom_write(addr, (uint8_t*)&rec, sizeof(rec)) != 0) {
+        return -1;
+    }
+    stats.next_seq++;
+    stats.dirty = false;
+    return 0;
+}
 
-        printf("Log %d: %.*s\n\n", i, len, (char*)entry);
+void stats_print(void) {
+    printf("[STATS]");
+    for (int i = 0; i < STAT_COUNT; i++) {
+        printf(" %s %lu%s", stat_names[i], (unsigned long)stats.count[i], i + 1 < STAT_COUNT ? "," : "\n");
     }
+}
+
+typedef struct {
+    bool     ready;
+    uint32_t next_seq;   // record seq lives in slot seq % STATE_SLOTS
+    bool     has_last;
+    simple_state_t last; // what the newest record holds, to skip identical writes
+    bool     queued;     // the newest record was queued this boot
+    uint32_t ticket;     // its bus ticket, for state_wait()
+    uint32_t failures;   // eeprom_bus_failures() when it was queued
+} state_journal_t;
+
+typedef struct {
+    int depth;           // nested state_begin() calls
+    Dispenser *pending;  // save_sm_state() deferred until commit/flush
+} state_txn_t;
+
+static state_journal_t journal;
+static state_txn_t txn;
+
+_Static_assert(sizeof(state_record_t) <= STATE_SLOT_SIZE, "state record must fit a journal slot");
+_Static_assert(EEPROM_PART_STATE_SIZE % STATE_SLOT_SIZE == 0, "state partition must hold whole slots");
+
+static bool state_integrity_ok(const simple_state_t *s) {
+    return s->state      == (uint8_t)~s->not_state      &&
+           s->pills_left == (uint8_t)~s->not_pills_left &&
+           s->calibrated == (uint8_t)~s->not_calibrated;
+}
+
+// Find the newest record with a good crc and complement bytes.
+// 0 = found, -1 = EEPROM error, -2 = no valid record
+static int scan_journal(simple_state_t *s) {
+    state_record_t rec;
+    bool found = false;
+    uint32_t newest = 0;
 
+    for (int i = 0; i < STATE_SLOTS; i++) {
+        uint16_t addr = STATE_ADDR + i * STATE_SLOT_SIZE;
+        if (eeprom_read(addr, (uint8_t*)&rec, sizeof(rec)) != 0) {
+            return -1;
+        }
+        if (crc16((uint8_t*)&rec, offsetof(state_record_t, crc)) != rec.crc ||
+            !state_integrity_ok(&rec.s)) {
+            continue;
+        }
+        if (!found || rec.seq > newest) {
+            found  = true;
+            newest = rec.seq;
+            memcpy(s, &rec.s, sizeof(*s));
+        }
+    }
+    journal.next_seq = found ? newest + 1 : 0;
+    journal.ready    = true;
+    journal.has_last = found;
+    if (found) {
+        journal.last = *s;
+    }
+    return found ? 0 : -2;
 }
+
 int save_state(simple_state_t *s) {
     simple_state_t buf= *s;
 
@@ -159,7 +460,8 @@ int save_state(simple_state_t *s) {
     buf.not_pills_left =~buf.pills_left;
 
     // motor progress
-    buf.current_steps_slot = s->current_steps_slot;
+    buf.position           = s->position;
+    buf.target             = s->target;
     buf.in_motion          = s->in_motion;
     buf.step_index       =s->step_index;
     buf.calibrated       = s->calibrated;
@@ -167,41 +469,111 @@ int save_state(simple_state_t *s) {
     buf.slot_done        =s->slot_done;
     buf.not_slot_done     =~buf.slot_done;
 
-    return eeprom_write(STATE_ADDR, (uint8_t*)&buf, sizeof(buf));
+    if (!journal.ready) {
+        simple_state_t old;
+        if (scan_journal(&old) == -1) {
+            return -1;
+        }
+    }
+    if (journal.has_last && memcmp(&journal.last, &buf, sizeof(buf)) == 0) {
+        return 0; // already on EEPROM
+    }
+    // Each save goes to the next slot, so wear is spread over the whole journal
+    state_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.seq = journal.next_seq;
+    rec.s   = buf;
+    rec.crc = crc16((uint8_t*)&rec, offsetof(state_record_t, crc));
+
+    uint16_t addr = STATE_ADDR + (rec.seq % STATE_SLOTS) * STATE_SLOT_SIZE;
+    uint32_t failures = eeprom_bus_failures();
+    if (write_pages(addr, (uint8_t*)&rec, sizeof(rec), &journal.ticket) != 0) {
+        return -1;
+    }
+    journal.queued   = true;
+    journal.failures = failures;
+    journal.next_seq++;
+    journal.last     = buf;
+    journal.has_last = true;
+    return 0;
 }
 
 int load_state(simple_state_t *s) {
     simple_state_t buf;
-    if (eeprom_read(STATE_ADDR, (uint8_t*)&buf, sizeof(buf)) != 0) {
-        return -1; // EEPROM error
+    int r = scan_journal(&buf);
+    if (r != 0) {
+        return r; // -1 EEPROM error, -2 data error
     }
 
-
-    if (buf.state         != (uint8_t)~buf.not_state      ||
-       buf.pills_left    != (uint8_t)~buf.not_pills_left ||
-       buf.calibrated    != (uint8_t)~buf.not_calibrated) {
-        return -2; //  data error
-       }
-
     memcpy(s, &buf, sizeof(buf));
     return 0; // OK
 }
-void save_sm_state(Dispenser *dis) {
-     if (!dis || !dis->motor) return;
+static void write_sm_state(Dispenser *dis) {
     simple_state_t s={0};
     s.state=dis->state;
     s.pills_left=dis->pills_left;
     s.in_motion = dis->motor->in_motion?1:0;
     s.calibrated=dis->motor->calibrated?1:0;
     s.step_index= dis->motor->step_index;
+    s.position  = (uint16_t)dis->motor->position;
+    s.target    = (uint16_t)dis->motor->target;
     s.slot_done=dis->slot_done;
     save_state(&s);
 }
 
+// Inside a transaction the write is deferred: every field change made
+// during one FSM transition ends up in a single record at commit.
+void save_sm_state(Dispenser *dis) {
+     if (!dis || !dis->motor) return;
+    if (txn.depth > 0) {
+        txn.pending = dis;
+        return;
+    }
+    write_sm_state(dis);
+}
 
+void state_begin(void) {
+    txn.depth++;
+}
 
+// Write the pending state now and wait until it is on the chip,
+// e.g. the in_motion flag before the wheel moves
+void state_flush(void) {
+    if (txn.pending) {
+        Dispenser *dis = txn.pending;
+        txn.pending = NULL;
+        write_sm_state(dis);
+    }
+    if (eeprom_flush() != 0) {
+        printf("[EEPROM] flush failed, %lu page writes lost since boot\n",
+               (unsigned long)eeprom_write_failures());
+    }
+}
 
+// Write the state now, also inside a transaction, without waiting for the
+// chip: progress markers such as the wheel position during a move
+void state_checkpoint(Dispenser *dis) {
+    if (!dis || !dis->motor) return;
+    write_sm_state(dis);
+}
 
+// Wait for the newest state record only, not for the log pages core1 may
+// have queued meanwhile. As in eeprom_write_sync(), any page lost in the
+// meantime counts as this one.
+int state_wait(void) {
+    if (!journal.queued) {
+        return 0;
+    }
+    if (eeprom_bus_wait_ticket(journal.ticket) != 0) {
+        return -1;
+    }
+    return eeprom_bus_failures() == journal.failures ? 0 : -1;
+}
 
-
-
+void state_commit(void) {
+    if (txn.depth > 0 && --txn.depth == 0 && txn.pending) {
+        Dispenser *dis = txn.pending;
+        txn.pending = NULL;
+        write_sm_state(dis);   // write-behind, no need to wait here
+    }
+}
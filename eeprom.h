@@ -7,50 +7,152 @@
 #include <stddef.h>
 #include "hardware/i2c.h"
 #include "board_config.h"
+#include "crc16.h"
+#include "eeprom_layout.h"
 
 #define I2C_PORT i2c0
+#define EEPROM_I2C_IRQ I2C0_IRQ
 #define I2C_SDA_PIN 16
 #define I2C_SCL_PIN 17
 
 #define I2C_BAUDRATE 100000
 #define EEPROM_I2C_ADDR 0x50
-#define EEPROM_STORE_ADDR (0x7fff-2)    // highest address avoid overflow
-#define EEPROM_TOTAL_BYTES 32768u
+#define EEPROM_STORE_ADDR (0x7fff-2)    // probe address for eeprom_available(), read only
 
-#define LOG_START_ADDR 0
-#define LOG_ENTRY_SIZE 64
-#define LOG_AREA_SIZE 2048
-#define LOG_MAX_ENTRIES 200
-#define LOG_STRING_MAX_LEN 61
+#define LOG_START_ADDR EEPROM_PART_LOG_ADDR
+#define LOG_ENTRY_SIZE 16
+#define LOG_AREA_SIZE EEPROM_PART_LOG_SIZE
+#define LOG_MAX_ENTRIES (LOG_AREA_SIZE / LOG_ENTRY_SIZE)
+#define LOG_STRING_MAX_LEN 61     // rendered text incl. '\0'
 
-#define STATE_ADDR 0X0800
+#define STATE_ADDR EEPROM_PART_STATE_ADDR
+#define STATE_SLOT_SIZE 32      // two journal slots per EEPROM page
+#define STATE_SLOTS (EEPROM_PART_STATE_SIZE / STATE_SLOT_SIZE)   // save_state() rotates through all of them
+
+#define CONFIG_ADDR EEPROM_PART_CONFIG_ADDR
+#define CONFIG_MAGIC 0x31474643u   // "CFG1"
+
+#define STATS_ADDR EEPROM_PART_STATS_ADDR
+#define STATS_SLOT_SIZE 32      // two journal slots per EEPROM page
+#define STATS_SLOTS (EEPROM_PART_STATS_SIZE / STATS_SLOT_SIZE)   // stats_save() rotates through all of them
+
+typedef enum {
+    LOG_EV_NONE,
+    LOG_EV_BOOT_LORA_OK,
+    LOG_EV_BOOT_LORA_FAIL,
+    LOG_EV_FRESH_BOOT,
+    LOG_EV_POWER_LOSS_MOVING,
+    LOG_EV_NOT_CALIBRATED,
+    LOG_EV_RESUME_DISPENSING,
+    LOG_EV_CALIBRATION_FAIL,
+    LOG_EV_CALIBRATION_DONE,
+    LOG_EV_DISPENSING_FINISH,
+    LOG_EV_DISPENSE_OK,
+    LOG_EV_DISPENSE_FAIL,
+    LOG_EV_RECOVERY_DONE,
+    LOG_EV_CYCLE_COMPLETE,
+    LOG_EV_STEP_SLIP,           // arg = index error in half-steps (int16)
+    LOG_EV_INDEX_LOST,          // arg = index error, 0 if the edge never came
+    LOG_EV_DISPENSE_MULTI,      // arg = impacts counted, 1 = pills landing together
+    LOG_EV_COUNT
+} log_event_id_t;
+
+// Binary log record, rendered to text only by read_log()/log_format()
+typedef struct {
+    uint32_t seq;          // record seq lives in slot seq % LOG_MAX_ENTRIES
+    uint32_t time;         // RTC time, seconds since 1970-01-01
+    uint8_t  event;        // log_event_id_t
+    uint8_t  day;          // day of the cycle, 0 = not dispensing
+    uint8_t  pills_left;
+    uint8_t  state;        // FSM state when logged
+    uint16_t arg;          // event specific
+    uint16_t crc;          // crc16 over everything above
+} log_record_t;
 
 typedef struct {
     uint8_t state;       // FSM state
     uint8_t not_state;   // ~state
     uint8_t pills_left;
     uint8_t not_pills_left;// ~pills_left
-    uint16_t current_steps_slot;
+    uint16_t position;     // wheel position, half-steps CW from the index edge
     uint16_t step_index;
     uint8_t in_motion;
     uint8_t calibrated;
     uint8_t not_calibrated;
     uint8_t slot_done;
     uint8_t not_slot_done;
+    uint16_t target;       // end of the move in flight when in_motion
 } simple_state_t;
 
+typedef struct {
+    uint32_t seq;          // newest valid record wins at boot
+    simple_state_t s;
+    uint16_t crc;          // crc16 over seq + s
+} state_record_t;
+
+// Settings that outlive a pill cycle, rewritten only when they change
+typedef struct {
+    uint32_t magic;
+    int32_t  steps_per_rev;  // half-steps per wheel revolution, 0 = never measured
+    uint16_t reserved;
+    uint16_t crc;            // crc16 over everything above
+} config_record_t;
+
+// Lifetime counters, never reset by a pill cycle. Counted in RAM and saved
+// at boot and at the end of each cycle, so a power loss costs at most the
+// counts of the cycle in progress.
+typedef enum {
+    STAT_BOOTS,
+    STAT_CYCLES,          // pill cycles completed
+    STAT_PILLS_OK,
+    STAT_PILLS_FAILED,
+    STAT_PILLS_MULTI,     // dispenses that dropped more than one pill
+    STAT_POWER_LOSSES,    // boots with the wheel in motion
+    STAT_COUNT
+} stat_id_t;
+
+typedef struct {
+    uint32_t seq;          // newest valid record wins at boot
+    uint32_t count[STAT_COUNT];
+    uint16_t reserved;
+    uint16_t crc;          // crc16 over everything above
+} stats_record_t;
+
 void setup_i2c(void);
 bool eeprom_available();
-int eeprom_write(uint16_t addr, uint8_t *data, size_t len);
+int eeprom_write(uint16_t addr, const uint8_t *data, size_t len);
 int eeprom_read(uint16_t addr, uint8_t *data, size_t len);
-uint16_t crc16(const uint8_t *data_p, size_t length);
+int eeprom_flush(void);     // barrier: every queued write is on the chip, -1 if one failed
+int eeprom_write_sync(uint16_t addr, const uint8_t *data, size_t len);   // write + wait, -1 if lost
+uint32_t eeprom_write_failures(void);   // pages lost since boot
+void eeprom_print_stats(void);
 
-int find_log();
-void write_log( char *msg);
+int log_init(void);
+uint32_t log_next_seq(void);
+uint32_t log_time_now(void);
+void write_log(log_record_t *rec);
+int log_format(const log_record_t *rec, char *buf, size_t len);
+bool log_record_valid(const log_record_t *rec, uint32_t slot);
 void read_log();
 void erase_log() ;
 
+int load_config(config_record_t *cfg);   // 0 = ok, -1 EEPROM error, -2 no valid record
+int save_config(config_record_t *cfg);
+
+int stats_init(void);     // load the newest record, count this boot and save it
+void stats_add(stat_id_t id);
+uint32_t stats_get(stat_id_t id);
+int stats_save(void);     // write-behind, only if a counter changed
+void stats_print(void);
+
 int save_state(simple_state_t *s);
 int load_state(simple_state_t *s);
 void save_sm_state(Dispenser *dis);
+
+// Coalesce save_sm_state() calls of one FSM transition into one write
+void state_begin(void);
+void state_flush(void);
+void state_commit(void);
+void state_checkpoint(Dispenser *dis);
+int state_wait(void);     // the newest state record is on the chip, -1 if it may be lost
 #endif //PILL_DISPENSER_5_EEPROM_H
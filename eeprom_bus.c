@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <string.h>
+#include <pico/time.h>
+#include <pico/sync.h>
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "eeprom_bus.h"
+#include "eeprom.h"
+
+typedef enum {
+    BUS_IDLE,          // chip ready for a new transfer
+    BUS_WRITING,       // page is being clocked out by DMA
+    BUS_WRITE_CYCLE,   // chip programming the page, next ACK poll scheduled
+    BUS_POLLING,       // ACK poll in flight
+    BUS_READING        // sequential read in flight
+} bus_state_t;
+
+typedef struct {
+    uint16_t addr;
+    uint8_t  len;
+    uint8_t  data[EEPROM_PAGE_SIZE];
+} page_write_t;
+
+typedef struct {
+    volatile bus_state_t state;
+    volatile int error;              // latched result of the last write
+    volatile uint32_t failures;      // pages lost since boot, never cleared
+    uint32_t issued;                 // tickets handed out
+    volatile uint32_t retired;       // pages programmed or lost, in ticket order
+    volatile int read_error;
+    volatile bool read_done;
+    volatile bool nacked;            // TX_ABRT seen during the current transfer
+    volatile uint32_t abort_source;
+    uint64_t cycle_start_us;         // STOP of the last page write
+    alarm_id_t poll_alarm;
+    int tx_chan;
+    int rx_chan;
+    uint16_t read_cmd;
+    uint16_t tx_words[2 + EEPROM_PAGE_SIZE];   // address + payload as IC_DATA_CMD words
+
+    // one reader at a time, reads come from both cores
+    mutex_t read_lock;
+
+    // write-behind queue, drained from the I2C/alarm IRQs
+    critical_section_t lock;
+    page_write_t queue[EEPROM_WRITE_QUEUE_LEN];
+    uint8_t q_head;
+    uint8_t q_tail;
+    volatile uint8_t q_count;
+} eeprom_bus_t;
+
+static eeprom_bus_t bus;
+
+static int64_t ack_poll_alarm(alarm_id_t id, void *user_data);
+
+// The page on the bus is lost; the queue behind it keeps draining
+static void write_failed(void) {
+    bus.error = -1;
+    bus.failures++;
+    bus.retired++;
+}
+
+// Called with bus.lock held whenever the chip is idle
+static void start_next_write(void) {
+    if (bus.state != BUS_IDLE || bus.q_count == 0) {
+        return;
+    }
+    page_write_t *w = &bus.queue[bus.q_tail];
+
+    bus.tx_words[0] = (uint16_t)(w->addr >> 8);
+    bus.tx_words[1] = (uint16_t)(w->addr & 0xFF);
+    for (size_t i = 0; i < w->len; i++) {
+        bus.tx_words[2 + i] = w->data[i];
+    }
+    bus.tx_words[1 + w->len] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    dma_channel_config c = dma_channel_get_default_config(bus.tx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(I2C_PORT, true));
+
+    bus.state = BUS_WRITING;
+    dma_channel_configure(bus.tx_chan, &c, &i2c_get_hw(I2C_PORT)->data_cmd,
+                          bus.tx_words, 2 + w->len, true);
+
+    bus.q_tail = (bus.q_tail + 1) % EEPROM_WRITE_QUEUE_LEN;
+    bus.q_count--;
+}
+
+static void set_idle(void) {
+    bus.state = BUS_IDLE;
+    start_next_write();
+}
+
+static void start_ack_poll(void) {
+    bus.state = BUS_POLLING;
+    // 1-byte read: the chip NACKs its address until the write cycle is over
+    i2c_get_hw(I2C_PORT)->data_cmd = I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_STOP_BITS;
+}
+
+static void schedule_ack_poll(void) {
+    bus.state = BUS_WRITE_CYCLE;
+    // fire_if_past would run the callback right here, with bus.lock already held
+    bus.poll_alarm = add_alarm_in_us(EEPROM_ACK_POLL_US, ack_poll_alarm, NULL, false);
+    if (bus.poll_alarm <= 0) {
+        // already due or no alarm slot left, poll straight away instead
+        bus.poll_alarm = 0;
+        start_ack_poll();
+    }
+}
+
+static int64_t ack_poll_alarm(alarm_id_t id, void *user_data) {
+    (void)id;
+    (void)user_data;
+    critical_section_enter_blocking(&bus.lock);
+    bus.poll_alarm = 0;
+    if (bus.state == BUS_WRITE_CYCLE) {
+        start_ack_poll();
+    }
+    critical_section_exit(&bus.lock);
+    return 0;
+}
+
+static void __not_in_flash_func(eeprom_bus_irq)(void) {
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    critical_section_enter_blocking(&bus.lock);
+    uint32_t stat = hw->intr_stat;
+
+    if (stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // Stop feeding the FIFO before clearing the abort, otherwise DMA starts a new transfer
+        dma_channel_abort(bus.tx_chan);
+        dma_channel_abort(bus.rx_chan);
+        bus.abort_source = hw->tx_abrt_source;
+        (void)hw->clr_tx_abrt;
+        bus.nacked = true;
+    }
+
+    if (stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void)hw->clr_stop_det;
+        bool nacked = bus.nacked;
+        bus.nacked = false;
+
+        switch (bus.state) {
+            case BUS_WRITING:
+                if (nacked) {
+                    write_failed();
+                    set_idle();
+                } else {
+                    bus.cycle_start_us = time_us_64();
+                    schedule_ack_poll();
+                }
+                break;
+
+            case BUS_POLLING:
+                while (hw->rxflr) {
+                    (void)hw->data_cmd;
+                }
+                if (!nacked) {
+                    bus.retired++;
+                    set_idle();   // chip answered: page is programmed
+                } else if (time_us_64() - bus.cycle_start_us > EEPROM_WRITE_CYCLE_MAX_US) {
+                    write_failed();
+                    set_idle();
+                } else {
+                    schedule_ack_poll();
+                }
+                break;
+
+            case BUS_READING:
+                if (nacked) {
+                    while (hw->rxflr) {
+                        (void)hw->data_cmd;
+                    }
+                }
+                bus.read_error = nacked ? -1 : 0;
+                bus.read_done  = true;
+                set_idle();
+                break;
+
+            default:
+                break;
+        }
+    }
+    critical_section_exit(&bus.lock);
+}
+
+// Bring the bus back to a known state after a timeout
+static void bus_reset(void) {
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    critical_section_enter_blocking(&bus.lock);
+    if (bus.poll_alarm > 0) {
+        cancel_alarm(bus.poll_alarm);
+        bus.poll_alarm = 0;
+    }
+    dma_channel_abort(bus.tx_chan);
+    dma_channel_abort(bus.rx_chan);
+    hw->enable = 0;
+    while (hw->rxflr) {
+        (void)hw->data_cmd;
+    }
+    (void)hw->clr_intr;
+    hw->enable = 1;
+    bus.nacked = false;
+    if (bus.state != BUS_IDLE && bus.state != BUS_READING) {
+        write_failed();   // the page in flight never made it
+    }
+    set_idle();   // keep draining whatever is still queued
+    critical_section_exit(&bus.lock);
+    printf("[EEPROM] bus reset (abort source 0x%lx)\n", (unsigned long)bus.abort_source);
+}
+
+// Take the bus for a read once every queued write has reached the chip
+static int claim_for_read(void) {
+    uint64_t deadline = time_us_64() + EEPROM_BUS_TIMEOUT_US;
+    uint8_t last_count = 0xFF;
+    for (;;) {
+        critical_section_enter_blocking(&bus.lock);
+        bool idle = bus.state == BUS_IDLE && bus.q_count == 0;
+        if (idle) {
+            bus.read_done  = false;
+            bus.read_error = 0;
+            bus.state      = BUS_READING;
+        }
+        uint8_t count = bus.q_count;
+        critical_section_exit(&bus.lock);
+        if (idle) {
+            return 0;
+        }
+        if (count != last_count) {
+            // queue is draining, restart the timeout
+            last_count = count;
+            deadline = time_us_64() + EEPROM_BUS_TIMEOUT_US;
+        } else if (time_us_64() > deadline) {
+            bus_reset();
+            return -1;
+        }
+        tight_loop_contents();
+    }
+}
+
+void eeprom_bus_init(void) {
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+
+    bus.tx_chan  = dma_claim_unused_channel(true);
+    bus.rx_chan  = dma_claim_unused_channel(true);
+    bus.read_cmd = I2C_IC_DATA_CMD_CMD_BITS;
+    bus.state    = BUS_IDLE;
+    bus.error    = 0;
+    bus.failures = 0;
+    bus.issued   = 0;
+    bus.retired  = 0;
+    bus.q_head   = 0;
+    bus.q_tail   = 0;
+    bus.q_count  = 0;
+    critical_section_init(&bus.lock);
+    mutex_init(&bus.read_lock);
+
+    // Only one device on this bus, so the target address is set once
+    hw->enable   = 0;
+    hw->tar      = EEPROM_I2C_ADDR;
+    hw->dma_tdlr = 4;    // keep a few words queued so SCL is never stretched
+    hw->dma_rdlr = 0;
+    hw->dma_cr   = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    hw->enable   = 1;
+
+    (void)hw->clr_intr;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+    irq_set_exclusive_handler(EEPROM_I2C_IRQ, eeprom_bus_irq);
+    irq_set_enabled(EEPROM_I2C_IRQ, true);
+}
+
+int eeprom_bus_write_page(uint16_t addr, const uint8_t *data, size_t len, uint32_t *ticket) {
+    if (len == 0 || len > EEPROM_PAGE_SIZE ||
+        (addr % EEPROM_PAGE_SIZE) + len > EEPROM_PAGE_SIZE) {
+        return -1;
+    }
+    uint64_t deadline = time_us_64() + EEPROM_BUS_TIMEOUT_US;
+    for (;;) {
+        critical_section_enter_blocking(&bus.lock);
+        if (bus.q_count < EEPROM_WRITE_QUEUE_LEN) {
+            page_write_t *w = &bus.queue[bus.q_head];
+            w->addr = addr;
+            w->len  = (uint8_t)len;
+            memcpy(w->data, data, len);
+            bus.q_head = (bus.q_head + 1) % EEPROM_WRITE_QUEUE_LEN;
+            bus.q_count++;
+            if (ticket) {
+                *ticket = bus.issued;
+            }
+            bus.issued++;
+            start_next_write();
+            critical_section_exit(&bus.lock);
+            return 0;
+        }
+        critical_section_exit(&bus.lock);
+
+        // queue full: back-pressure until the IRQs retire one page
+        if (time_us_64() > deadline) {
+            bus_reset();
+            return -1;
+        }
+        tight_loop_contents();
+    }
+}
+
+static int read_locked(uint16_t addr, uint8_t *data, size_t len) {
+    if (claim_for_read() != 0) {
+        return -1;
+    }
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+
+    dma_channel_config rx = dma_channel_get_default_config(bus.rx_chan);
+    channel_config_set_transfer_data_size(&rx, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx, false);
+    channel_config_set_write_increment(&rx, true);
+    channel_config_set_dreq(&rx, i2c_get_dreq(I2C_PORT, false));
+    dma_channel_configure(bus.rx_chan, &rx, data, &hw->data_cmd, len, true);
+
+    hw->data_cmd = (uint8_t)(addr >> 8);
+    hw->data_cmd = (uint8_t)(addr & 0xFF);
+
+    uint64_t deadline = time_us_64() + EEPROM_BUS_TIMEOUT_US + len * EEPROM_BYTE_TIMEOUT_US;
+
+    // All but the last read command come from DMA, the chip auto-increments across pages
+    if (len > 1) {
+        dma_channel_config tx = dma_channel_get_default_config(bus.tx_chan);
+        channel_config_set_transfer_data_size(&tx, DMA_SIZE_16);
+        channel_config_set_read_increment(&tx, false);
+        channel_config_set_write_increment(&tx, false);
+        channel_config_set_dreq(&tx, i2c_get_dreq(I2C_PORT, true));
+        dma_channel_configure(bus.tx_chan, &tx, &hw->data_cmd, &bus.read_cmd, len - 1, true);
+
+        while (dma_channel_is_busy(bus.tx_chan)) {
+            if (time_us_64() > deadline) {
+                bus_reset();
+                return -1;
+            }
+            tight_loop_contents();
+        }
+    }
+    // An address NACK can land at any point from here on. Once the IRQ has
+    // cleared TX_ABRT the FIFO takes words again, so the last read command
+    // only goes out if the transfer is still alive, and under the lock.
+    critical_section_enter_blocking(&bus.lock);
+    if (!bus.nacked && !bus.read_done) {
+        hw->data_cmd = I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_STOP_BITS;
+    }
+    critical_section_exit(&bus.lock);
+
+    while (!bus.read_done || dma_channel_is_busy(bus.rx_chan)) {
+        if (bus.nacked) {
+            // nothing more comes in, don't leave a channel armed on the FIFO
+            dma_channel_abort(bus.tx_chan);
+            dma_channel_abort(bus.rx_chan);
+        }
+        if (time_us_64() > deadline) {
+            bus_reset();
+            return -1;
+        }
+        tight_loop_contents();
+    }
+    return bus.read_error;
+}
+
+int eeprom_bus_read(uint16_t addr, uint8_t *data, size_t len) {
+    if (len == 0 || (uint32_t)addr + len > EEPROM_TOTAL_BYTES) {
+        return -1;
+    }
+    mutex_enter_blocking(&bus.read_lock);
+    int r = read_locked(addr, data, len);
+    mutex_exit(&bus.read_lock);
+    return r;
+}
+
+bool eeprom_bus_busy(void) {
+    return bus.state != BUS_IDLE || bus.q_count > 0;
+}
+
+int eeprom_bus_drain(void) {
+    uint64_t deadline = time_us_64() + EEPROM_BUS_TIMEOUT_US;
+    uint8_t last_count = bus.q_count;
+    while (eeprom_bus_busy()) {
+        if (bus.q_count != last_count) {
+            last_count = bus.q_count;
+            deadline = time_us_64() + EEPROM_BUS_TIMEOUT_US;
+        } else if (time_us_64() > deadline) {
+            bus_reset();
+            return -1;
+        }
+        tight_loop_contents();
+    }
+    return 0;
+}
+
+int eeprom_bus_wait_ticket(uint32_t ticket) {
+    uint64_t deadline = time_us_64() + EEPROM_BUS_TIMEOUT_US;
+    uint32_t last = bus.retired;
+    while ((int32_t)(bus.retired - ticket) <= 0) {
+        if (bus.retired != last) {
+            // pages ahead of it are retiring, restart the timeout
+            last = bus.retired;
+            deadline = time_us_64() + EEPROM_BUS_TIMEOUT_US;
+        } else if (time_us_64() > deadline) {
+            bus_reset();
+            return -1;
+        }
+        tight_loop_contents();
+    }
+    return 0;
+}
+
+int eeprom_bus_wait(void) {
+    int r = eeprom_bus_drain();
+    int err = bus.error;
+    bus.error = 0;
+    return r != 0 ? r : err;
+}
+
+uint32_t eeprom_bus_failures(void) {
+    return bus.failures;
+}
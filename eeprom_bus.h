@@ -0,0 +1,56 @@
+#ifndef PILL_DISPENSER_EEPROM_BUS_H
+#define PILL_DISPENSER_EEPROM_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define EEPROM_PAGE_SIZE         64
+#define EEPROM_ACK_POLL_US       500     // delay between ACK polls while the chip is programming a page
+#define EEPROM_TWC_US            5000    // datasheet write cycle time, max
+#define EEPROM_WRITE_CYCLE_MAX_US (2 * EEPROM_TWC_US)   // give up on a page after twice tWC
+#define EEPROM_BYTE_US           90      // one byte + ACK at 100 kHz
+#define EEPROM_BYTE_TIMEOUT_US   200     // per byte of a read, generous over EEPROM_BYTE_US
+#define EEPROM_BUS_TIMEOUT_US    50000   // upper bound for any single wait on the bus
+#define EEPROM_WRITE_QUEUE_LEN   8       // pages staged in RAM ahead of the chip
+
+// One full page on a chip within its datasheet: address and data bytes, the
+// write cycle and the ACK poll that sees its end
+#define EEPROM_PAGE_WRITE_MAX_US ((3 + EEPROM_PAGE_SIZE) * EEPROM_BYTE_US + EEPROM_TWC_US + \
+                                  EEPROM_ACK_POLL_US + 2 * EEPROM_BYTE_US)
+
+// Interrupt/DMA driven transport under eeprom_write()/eeprom_read().
+// Page writes are copied into a bounded write-behind queue and return at once.
+// The I2C/alarm IRQs clock each page out by DMA, ACK-poll the chip through its
+// write cycle and start the next queued page, so nothing waits on the FSM side.
+void eeprom_bus_init(void);
+
+// Queue one page write. The range must not cross a page boundary.
+// Only blocks when the queue is full. Every page takes the next ticket
+// (stored in *ticket, may be NULL); pages retire in ticket order.
+int eeprom_bus_write_page(uint16_t addr, const uint8_t *data, size_t len, uint32_t *ticket);
+
+// Sequential read of any length. Queued writes are drained first so reads
+// always see them; blocks until the data is in memory. Safe from both cores,
+// writes already are (the queue is under a spin lock).
+int eeprom_bus_read(uint16_t addr, uint8_t *data, size_t len);
+
+// True while pages are queued, in flight, or being programmed
+bool eeprom_bus_busy(void);
+
+// Flush barrier: wait until every queued page is programmed.
+// Returns -1 if a write failed or timed out since the last call.
+int eeprom_bus_wait(void);
+
+// Same wait, but the latched error is left for eeprom_bus_wait(); writers on
+// the other core check eeprom_bus_failures() instead. -1 only on a timeout.
+int eeprom_bus_drain(void);
+
+// Wait until the page with this ticket is programmed or lost, without
+// waiting for the pages queued behind it. -1 only on a timeout.
+int eeprom_bus_wait_ticket(uint32_t ticket);
+
+// Pages lost to a NACK, a write cycle timeout or a bus reset since boot
+uint32_t eeprom_bus_failures(void);
+
+#endif //PILL_DISPENSER_EEPROM_BUS_H
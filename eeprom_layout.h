@@ -0,0 +1,36 @@
+#ifndef PILL_DISPENSER_EEPROM_LAYOUT_H
+#define PILL_DISPENSER_EEPROM_LAYOUT_H
+
+#include "eeprom_bus.h"
+
+// Partition table of the 24LC256 (32 KB). Every EEPROM user takes its
+// addresses from here; the checks below fail the build on any overlap.
+#define EEPROM_TOTAL_BYTES 32768u
+
+#define EEPROM_PART_STATE_ADDR   0x0000u   // state journal (wear-leveled)
+#define EEPROM_PART_STATE_SIZE   0x0800u
+#define EEPROM_PART_CONFIG_ADDR  0x0800u   // calibration and other settings
+#define EEPROM_PART_CONFIG_SIZE  0x0100u
+#define EEPROM_PART_STATS_ADDR   0x0900u   // lifetime counters (wear-leveled)
+#define EEPROM_PART_STATS_SIZE   0x0100u
+#define EEPROM_PART_INDEX_ADDR   0x0A00u   // per-block summaries of the log
+#define EEPROM_PART_INDEX_SIZE   0x0E00u
+#define EEPROM_PART_LOG_ADDR     0x1800u   // event log ring, rest of the chip
+#define EEPROM_PART_LOG_SIZE     (EEPROM_TOTAL_BYTES - EEPROM_PART_LOG_ADDR)
+
+#define EEPROM_PART_END(part) (EEPROM_PART_##part##_ADDR + EEPROM_PART_##part##_SIZE)
+
+_Static_assert(EEPROM_PART_END(STATE)  <= EEPROM_PART_CONFIG_ADDR, "state journal overlaps config");
+_Static_assert(EEPROM_PART_END(CONFIG) <= EEPROM_PART_STATS_ADDR,  "config overlaps stats");
+_Static_assert(EEPROM_PART_END(STATS)  <= EEPROM_PART_INDEX_ADDR,  "stats overlaps log index");
+_Static_assert(EEPROM_PART_END(INDEX)  <= EEPROM_PART_LOG_ADDR,    "log index overlaps log");
+_Static_assert(EEPROM_PART_END(LOG)    <= EEPROM_TOTAL_BYTES,      "log runs past the end of the chip");
+
+// Page aligned, so a record never shares a page with another partition
+_Static_assert(EEPROM_PART_STATE_ADDR  % EEPROM_PAGE_SIZE == 0, "state journal not page aligned");
+_Static_assert(EEPROM_PART_CONFIG_ADDR % EEPROM_PAGE_SIZE == 0, "config not page aligned");
+_Static_assert(EEPROM_PART_STATS_ADDR  % EEPROM_PAGE_SIZE == 0, "stats not page aligned");
+_Static_assert(EEPROM_PART_INDEX_ADDR  % EEPROM_PAGE_SIZE == 0, "log index not page aligned");
+_Static_assert(EEPROM_PART_LOG_ADDR    % EEPROM_PAGE_SIZE == 0, "log not page aligned");
+
+#endif //PILL_DISPENSER_EEPROM_LAYOUT_H
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+#include "hardware/structs/iobank0.h"
+#include "gpio_irq.h"
+
+typedef struct {
+    gpio_irq_handler_t handler;   // NULL = pin not registered
+    void *ctx;
+    gpio_irq_filter_t f;
+    gpio_irq_stats_t stats;
+    uint64_t last_us;       // last accepted edge
+    uint64_t burst_start_us;
+    uint32_t burst_count;
+    uint64_t unmask_at_us;  // 0 = not masked
+} gpio_irq_pin_t;
+
+static gpio_irq_pin_t pins[NUM_BANK0_GPIOS];
+
+// One hardware alarm re-enables masked pins. Its IRQ has the default
+// priority like IO_IRQ_BANK0, so the two never preempt each other.
+static int unmask_alarm_num = -1;
+static uint64_t unmask_alarm_due;   // what the alarm is armed for, 0 = idle
+
+// Four event bits per pin, eight pins per register
+#define PIN_REG(gpio)   ((gpio) / 8)
+#define PIN_SHIFT(gpio) (4 * ((gpio) % 8))
+
+// The IRQ enable/status registers of the core the pins were registered on
+static __force_inline io_irq_ctrl_hw_t *irq_ctrl(void) {
+    return get_core_num() ? &io_bank0_hw->proc1_irq_ctrl : &io_bank0_hw->proc0_irq_ctrl;
+}
+
+static void __not_in_flash_func(arm_unmask_alarm)(uint64_t due) {
+    uint32_t bit = 1u << unmask_alarm_num;
+    unmask_alarm_due = due;
+    timer_hw->alarm[unmask_alarm_num] = (uint32_t)due;
+    // The alarm compares the low word for equality: if that moment already
+    // passed, it would not fire for another 71 minutes, so force it
+    if ((int32_t)((uint32_t)due - timer_hw->timerawl) <= 0) {
+        hw_set_bits(&timer_hw->intf, bit);
+    }
+}
+
+static void __not_in_flash_func(unmask_irq)(void) {
+    uint32_t bit = 1u << unmask_alarm_num;
+    hw_clear_bits(&timer_hw->intf, bit);
+    timer_hw->intr = bit;
+
+    uint64_t now  = gpio_irq_now_us();
+    uint64_t next = 0;
+    io_irq_ctrl_hw_t *ctrl = irq_ctrl();
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        gpio_irq_pin_t *p = &pins[gpio];
+        if (!p->unmask_at_us) {
+            continue;
+        }
+        if (p->unmask_at_us <= now) {
+            p->unmask_at_us = 0;
+            // edges latched while masked are stale
+            io_bank0_hw->intr[PIN_REG(gpio)] = p->f.events << PIN_SHIFT(gpio);
+            hw_set_bits(&ctrl->inte[PIN_REG(gpio)], p->f.events << PIN_SHIFT(gpio));
+        } else if (!next || p->unmask_at_us < next) {
+            next = p->unmask_at_us;
+        }
+    }
+    unmask_alarm_due = 0;
+    if (next) {
+        arm_unmask_alarm(next);
+    }
+}
+
+static void __not_in_flash_func(mask_pin)(uint gpio, gpio_irq_pin_t *p, uint32_t us) {
+    if (p->unmask_at_us) {
+        return;   // already masked
+    }
+    hw_clear_bits(&irq_ctrl()->inte[PIN_REG(gpio)], p->f.events << PIN_SHIFT(gpio));
+    p->stats.masks++;
+    p->unmask_at_us = gpio_irq_now_us() + us;
+    if (!unmask_alarm_due || p->unmask_at_us < unmask_alarm_due) {
+        arm_unmask_alarm(p->unmask_at_us);
+    }
+}
+
+// false = drop this edge
+static bool __not_in_flash_func(accept_edge)(uint gpio, gpio_irq_pin_t *p) {
+    uint64_t now = gpio_irq_now_us();
+
+    // Every edge counts towards the burst, glitches included: they cost an IRQ too
+    if (p->f.burst_max) {
+        if (now - p->burst_start_us >= p->f.burst_window_us) {
+            p->burst_start_us = now;
+            p->burst_count    = 0;
+        }
+        if (++p->burst_count > p->f.burst_max) {
+            p->stats.dropped_burst++;
+            mask_pin(gpio, p, p->f.storm_mask_us);
+            return false;
+        }
+    }
+    if (p->f.min_gap_us && p->stats.accepted && now - p->last_us < p->f.min_gap_us) {
+        p->stats.dropped_gap++;
+        return false;
+    }
+    p->last_us = now;
+    p->stats.accepted++;
+    if (p->f.hold_off_us) {
+        mask_pin(gpio, p, p->f.hold_off_us);
+    }
+    return true;
+}
+
+// Exclusive IO_IRQ_BANK0 handler in place of the SDK's, which runs from
+// flash: walk this core's pending status, ack edges, dispatch by pin
+static void __not_in_flash_func(gpio_irq_bank0)(void) {
+    io_irq_ctrl_hw_t *ctrl = irq_ctrl();
+    for (uint reg = 0; reg < PIN_REG(NUM_BANK0_GPIOS - 1) + 1; reg++) {
+        uint32_t ints = ctrl->ints[reg];
+        for (uint gpio = reg * 8; ints; gpio++, ints >>= 4) {
+            uint32_t events = ints & 0xFu;
+            if (!events) {
+                continue;
+            }
+            io_bank0_hw->intr[reg] = events << PIN_SHIFT(gpio);   // level bits ignore this
+            gpio_irq_pin_t *p = &pins[gpio];
+            if (p->handler && accept_edge(gpio, p)) {
+                p->handler(p->ctx, gpio, events);
+            }
+        }
+    }
+}
+
+void gpio_irq_register(uint gpio, gpio_irq_handler_t handler, void *ctx,
+                       const gpio_irq_filter_t *f) {
+    if (gpio >= NUM_BANK0_GPIOS) {
+        return;
+    }
+    if (unmask_alarm_num < 0) {
+        unmask_alarm_num = hardware_alarm_claim_unused(true);
+        hw_set_bits(&timer_hw->inte, 1u << unmask_alarm_num);
+        irq_set_exclusive_handler(TIMER_IRQ_0 + unmask_alarm_num, unmask_irq);
+        irq_set_enabled(TIMER_IRQ_0 + unmask_alarm_num, true);
+        irq_set_exclusive_handler(IO_IRQ_BANK0, gpio_irq_bank0);
+        irq_set_enabled(IO_IRQ_BANK0, true);
+    }
+    gpio_irq_pin_t *p = &pins[gpio];
+    gpio_set_irq_enabled(gpio, p->f.events, false);
+    memset(p, 0, sizeof(*p));
+    p->f       = *f;
+    p->ctx     = ctx;
+    p->handler = handler;
+    gpio_set_irq_enabled(gpio, f->events, true);
+}
+
+const gpio_irq_stats_t *gpio_irq_stats(uint gpio) {
+    return gpio < NUM_BANK0_GPIOS ? &pins[gpio].stats : NULL;
+}
+
+void gpio_irq_print_stats(void) {
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        const gpio_irq_pin_t *p = &pins[gpio];
+        if (!p->handler) {
+            continue;
+        }
+        printf("[IRQ] gpio %u: %lu accepted, %lu glitches, %lu over burst, %lu masks\n", gpio,
+               (unsigned long)p->stats.accepted, (unsigned long)p->stats.dropped_gap,
+               (unsigned long)p->stats.dropped_burst, (unsigned long)p->stats.masks);
+    }
+}
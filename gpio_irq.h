@@ -0,0 +1,58 @@
+#ifndef PILL_DISPENSER_GPIO_IRQ_H
+#define PILL_DISPENSER_GPIO_IRQ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "hardware/structs/timer.h"
+
+// time_us_64() for RAM-resident IRQ code: the SDK function lives in flash.
+// Same lock-free read of the 64-bit counter, retried if the high word moved.
+static __force_inline uint64_t gpio_irq_now_us(void) {
+    uint32_t hi = timer_hw->timerawh;
+    uint32_t lo;
+    for (;;) {
+        lo = timer_hw->timerawl;
+        uint32_t next_hi = timer_hw->timerawh;
+        if (hi == next_hi) {
+            break;
+        }
+        hi = next_hi;
+    }
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Called from the GPIO IRQ for an accepted edge. Must be __not_in_flash_func.
+typedef void (*gpio_irq_handler_t)(void *ctx, uint gpio, uint32_t events);
+
+// Per-pin edge filter in front of the handler. Zero fields are off.
+typedef struct {
+    uint32_t events;        // GPIO_IRQ_* the pin is enabled for, restored after masking
+    uint32_t min_gap_us;    // edges closer than this to the last accepted one are glitches
+    uint32_t burst_max;     // more edges than this within burst_window_us ...
+    uint32_t burst_window_us;
+    uint32_t storm_mask_us; // ... mask the pin this long
+    uint32_t hold_off_us;   // mask the pin this long after every accepted edge
+} gpio_irq_filter_t;
+
+typedef struct {
+    uint32_t accepted;
+    uint32_t dropped_gap;   // glitches closer than min_gap_us
+    uint32_t dropped_burst; // edges over the burst limit
+    uint32_t masks;         // times the pin was masked (hold-off or storm)
+} gpio_irq_stats_t;
+
+// An exclusive IO_IRQ_BANK0 handler dispatches by pin number through a
+// table, so each driver registers its own handler and context and the others
+// never see its edges. Nothing else may use the SDK GPIO callback. The
+// dispatcher, the filter and the unmask alarm IRQ all run from RAM.
+// Enables the pin's IRQ for f->events. The IRQ rate of a filtered pin is
+// bounded by burst_max per window however noisy the input is, because a
+// storm masks the pin in hardware until an alarm re-enables it.
+void gpio_irq_register(uint gpio, gpio_irq_handler_t handler, void *ctx,
+                       const gpio_irq_filter_t *f);
+
+const gpio_irq_stats_t *gpio_irq_stats(uint gpio);
+void gpio_irq_print_stats(void);
+
+#endif //PILL_DISPENSER_GPIO_IRQ_H
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "io_worker.h"
+#include "lorawan.h"
+#include "log_export.h"
+
+typedef enum {
+    IO_REQ_LOG,
+    IO_REQ_UPLINK,
+    IO_REQ_CONNECT
+} io_req_kind_t;
+
+typedef struct {
+    uint8_t kind;
+    bool    uplink;                    // IO_REQ_LOG: also send the formatted line
+    union {
+        log_record_t rec;
+        char text[LOG_STRING_MAX_LEN];
+    };
+} io_req_t;
+
+typedef struct {
+    io_req_t ring[IO_QUEUE_LEN];
+    volatile uint32_t head;            // written by core0 only
+    volatile uint32_t tail;            // written by core1 only
+    io_stats_t stats;                  // written by core0, except done/uplinks_shed
+    volatile int8_t connect_result;    // IO_REQ_CONNECT: -1 = pending, set by core1
+} io_queue_t;
+
+static io_queue_t io;
+
+_Static_assert((IO_QUEUE_LEN & (IO_QUEUE_LEN - 1)) == 0, "queue length must be a power of two");
+
+static void handle(const io_req_t *req, uint32_t depth) {
+    const char *text = req->text;
+    char line[LOG_STRING_MAX_LEN];
+
+    if (req->kind == IO_REQ_CONNECT) {
+        // The UART IRQ gets installed on the core that calls lorawan_init(),
+        // so the join and every later uplink must stay on this core
+        lorawan_init();
+        bool ok = handle_lorawan();
+        if (ok) {
+            lorawan_send_message("Group 8 LoraWan Connected!");
+        }
+        io.connect_result = ok ? 1 : 0;
+        return;
+    }
+    if (req->kind == IO_REQ_LOG) {
+        log_record_t rec = req->rec;
+        write_log(&rec);
+        if (!req->uplink) {
+            return;
+        }
+        log_format(&rec, line, sizeof(line));
+        text = line;
+    }
+    if (depth >= IO_UPLINK_SHED) {
+        io.stats.uplinks_shed++;
+        return;
+    }
+    lorawan_send_message(text);
+}
+
+static void io_worker_main(void) {
+    for (;;) {
+        uint32_t tail = io.tail;
+        uint32_t head = io.head;
+        if (tail == head) {
+            // Service commands read the log, so they run on the core that
+            // writes it; core0 sends an event after every push
+            log_export_poll();
+            best_effort_wfe_or_timeout(make_timeout_time_ms(IO_SERVICE_POLL_MS));
+            continue;
+        }
+        __dmb();       // request contents before using them
+        handle(&io.ring[tail % IO_QUEUE_LEN], head - tail);
+        __dmb();
+        io.tail = tail + 1;
+        io.stats.done++;
+        __sev();       // wake core0 if it waits for space
+    }
+}
+
+void io_worker_start(void) {
+    io.head = 0;
+    io.tail = 0;
+    memset(&io.stats, 0, sizeof(io.stats));
+    multicore_launch_core1(io_worker_main);
+}
+
+// Slot for the next request; waits while the ring is full
+static io_req_t *claim(void) {
+    uint32_t head = io.head;
+    if (head - io.tail >= IO_QUEUE_LEN) {
+        uint64_t start = time_us_64();
+        io.stats.full_waits++;
+        while (head - io.tail >= IO_QUEUE_LEN) {
+            __wfe();
+        }
+        uint32_t waited = (uint32_t)(time_us_64() - start);
+        if (waited > io.stats.max_wait_us) {
+            io.stats.max_wait_us = waited;
+        }
+        printf("[IO] queue full, waited %lu us\n", (unsigned long)waited);
+    }
+    return &io.ring[head % IO_QUEUE_LEN];
+}
+
+static void publish(void) {
+    __dmb();           // request contents visible before the new head
+    io.head++;
+    uint32_t depth = io.head - io.tail;
+    if (depth > io.stats.max_depth) {
+        io.stats.max_depth = depth;
+    }
+    io.stats.queued++;
+    __sev();
+}
+
+void io_log(const log_record_t *rec, bool uplink) {
+    io_req_t *req = claim();
+    req->kind   = IO_REQ_LOG;
+    req->uplink = uplink;
+    req->rec    = *rec;
+    publish();
+}
+
+void io_uplink(const char *text) {
+    io_req_t *req = claim();
+    req->kind   = IO_REQ_UPLINK;
+    req->uplink = true;
+    strncpy(req->text, text, sizeof(req->text) - 1);
+    req->text[sizeof(req->text) - 1] = '\0';
+    publish();
+}
+
+bool io_lora_connect(void) {
+    io_req_t *req = claim();
+    req->kind   = IO_REQ_CONNECT;
+    req->uplink = false;
+    io.connect_result = -1;
+    publish();
+    while (io.connect_result < 0) {
+        __wfe();       // core1 sends an event once the request is done
+    }
+    return io.connect_result > 0;
+}
+
+const io_stats_t *io_stats(void) {
+    return &io.stats;
+}
+
+void io_print_stats(void) {
+    printf("[IO] %lu queued, %lu done, max depth %lu, %lu full waits (max %lu us), %lu uplinks shed\n",
+           (unsigned long)io.stats.queued, (unsigned long)io.stats.done,
+           (unsigned long)io.stats.max_depth, (unsigned long)io.stats.full_waits,
+           (unsigned long)io.stats.max_wait_us, (unsigned long)io.stats.uplinks_shed);
+}
@@ -0,0 +1,43 @@
+#ifndef PILL_DISPENSER_IO_WORKER_H
+#define PILL_DISPENSER_IO_WORKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "eeprom.h"
+
+#define IO_QUEUE_LEN    16   // requests in flight, power of two
+#define IO_UPLINK_SHED  8    // queue this deep: log only, skip the radio until it drains
+#define IO_SERVICE_POLL_MS 20   // stdio service commands are polled this often while idle
+
+typedef struct {
+    uint32_t queued;
+    uint32_t done;
+    uint32_t full_waits;     // core0 found the queue full and had to wait
+    uint32_t max_wait_us;    // longest of those waits
+    uint32_t max_depth;
+    uint32_t uplinks_shed;   // uplinks skipped under back-pressure
+} io_stats_t;
+
+// Core1 I/O worker: EEPROM log writes and LoRa uplinks leave core0 through a
+// lock-free single-producer/single-consumer ring, so a 15 s radio exchange
+// never holds up motion or sensing. Core0 is the only producer. The log and
+// the log index are only touched on core1: the worker also serves the stdio
+// log commands (log_export_poll()) whenever the ring is empty.
+void io_worker_start(void);
+
+// Queue a log record (time/event/... filled in, seq and crc are set by
+// write_log() on core1), optionally sent over LoRaWAN as text afterwards.
+// Only waits when the queue is full.
+void io_log(const log_record_t *rec, bool uplink);
+
+// Queue a free-text LoRaWAN uplink
+void io_uplink(const char *text);
+
+// Init the modem and join on core1, which then owns UART1 and its IRQ, and
+// wait for the result. Sends the "connected" uplink on success.
+bool io_lora_connect(void);
+
+const io_stats_t *io_stats(void);
+void io_print_stats(void);
+
+#endif //PILL_DISPENSER_IO_WORKER_H
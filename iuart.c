@@ -77,7 +77,9 @@ int iuart_write(int uart_nr, const uint8_t *buffer, int size)
         queue_add_blocking(&u->tx, buffer++);
         ++count;
     }
-    // disable interrupts on NVIC while managing transmit interrupts
+    // disable interrupts on NVIC while managing transmit interrupts. The NVIC
+    // is per core, so this only works on the core that ran iuart_setup():
+    // UART1 (LoRa) is set up and used on core1 only, by the I/O worker
     irq_set_enabled(u->irqn, false);
 #if 1
     // if transmit interrupt is not enabled we need to enable it and give fifo an initial filling
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <ctype.h>
+#include "pico/stdlib.h"
+#include "log_export.h"
+#include "eeprom.h"
+#include "log_index.h"
+
+#define LOG_EXPORT_CMD_LEN 12
+
+static void put_bytes(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        putchar_raw(data[i]);   // binary safe, no CR/LF translation
+    }
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void send_frame(uint8_t type, uint32_t offset, const uint8_t *payload, uint16_t len) {
+    static uint8_t frame[2 + 7 + LOG_EXPORT_CHUNK + 2];
+
+    frame[0] = LOG_EXPORT_SYNC0;
+    frame[1] = LOG_EXPORT_SYNC1;
+    frame[2] = type;
+    put_u32(&frame[3], offset);
+    put_u16(&frame[7], len);
+    for (uint16_t i = 0; i < len; i++) {
+        frame[9 + i] = payload[i];
+    }
+    put_u16(&frame[9 + len], crc16(&frame[2], 7 + len));
+    put_bytes(frame, 9 + len + 2);
+}
+
+void log_export(uint32_t offset) {
+    const uint32_t area = LOG_AREA_SIZE;
+    uint8_t buf[LOG_EXPORT_CHUNK];
+
+    if (!eeprom_available()) {
+        printf("EEPROM not available\n");
+        return;
+    }
+    if (offset > area) {
+        offset = area;
+    }
+
+    // Header tells the decoder how to split the area into records
+    uint8_t hdr[12];
+    put_u16(&hdr[0], LOG_ENTRY_SIZE);
+    put_u16(&hdr[2], LOG_MAX_ENTRIES);
+    put_u32(&hdr[4], log_next_seq());
+    put_u32(&hdr[8], area);
+    send_frame(LOG_EXPORT_HEADER, offset, hdr, sizeof(hdr));
+
+    // A failed chunk is skipped, the decoder reports the gap so it can be resumed
+    uint32_t errors = 0;
+    while (offset < area) {
+        uint16_t len = (area - offset) < LOG_EXPORT_CHUNK ? (uint16_t)(area - offset) : LOG_EXPORT_CHUNK;
+        if (eeprom_read(LOG_START_ADDR + offset, buf, len) == 0) {
+            send_frame(LOG_EXPORT_DATA, offset, buf, len);
+        } else {
+            errors++;
+        }
+        offset += len;
+    }
+
+    uint8_t end[4];
+    put_u32(&end[0], errors);
+    send_frame(LOG_EXPORT_END, offset, end, sizeof(end));
+    stdio_flush();
+}
+
+static uint32_t parse_hex(const char *s) {
+    uint32_t v = 0;
+    for (; isxdigit((unsigned char)*s); s++) {
+        char h = (char)toupper((unsigned char)*s);
+        v = (v << 4) | (uint32_t)(h <= '9' ? h - '0' : h - 'A' + 10);
+    }
+    return v;
+}
+
+static bool print_match(const log_record_t *rec, void *ctx) {
+    (void)ctx;
+    char line[LOG_STRING_MAX_LEN];
+    log_format(rec, line, sizeof(line));
+    printf("Log %lu: %s\n", (unsigned long)rec->seq, line);
+    return true;
+}
+
+void log_export_poll(void) {
+    static char cmd[LOG_EXPORT_CMD_LEN];
+    static int cmd_len = 0;
+
+    int c = getchar_timeout_us(0);
+    while (c != PICO_ERROR_TIMEOUT) {
+        if (c == '\r' || c == '\n') {
+            cmd[cmd_len] = '\0';
+            if (cmd_len > 0 && toupper((unsigned char)cmd[0]) == 'L') {
+                read_log();
+            } else if (cmd_len > 0 && toupper((unsigned char)cmd[0]) == 'X') {
+                log_export(parse_hex(&cmd[1]));
+            } else if (cmd_len > 0 && toupper((unsigned char)cmd[0]) == 'Q') {
+                log_query_t q = { .event_mask = LOG_EV_BIT(parse_hex(&cmd[1]) & 0x1F) };
+                int n = log_query(&q, print_match, NULL);
+                printf("[LOG] %d matches\n", n);
+            }
+            cmd_len = 0;
+        } else if (cmd_len < LOG_EXPORT_CMD_LEN - 1) {
+            cmd[cmd_len++] = (char)c;
+        }
+        c = getchar_timeout_us(0);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef PILL_DISPENSER_LOG_EXPORT_H
+#define PILL_DISPENSER_LOG_EXPORT_H
+
+#include <stdint.h>
+
+#define LOG_EXPORT_CHUNK 256       // bytes per frame, one sequential EEPROM read
+#define LOG_EXPORT_SYNC0 0xA5
+#define LOG_EXPORT_SYNC1 0x5A
+
+// Frame: A5 5A | type | offset u32 | len u16 | payload | crc16 over type..payload
+// (all little endian). 'H' header, 'D' raw log area bytes, 'E' end.
+// Decoded on the host by tools/log_decode.py
+#define LOG_EXPORT_HEADER 'H'
+#define LOG_EXPORT_DATA   'D'
+#define LOG_EXPORT_END    'E'
+
+// Stream the raw log area over stdio starting at byte offset (to resume a dump)
+void log_export(uint32_t offset);
+
+// Service commands on stdio, polled by the I/O worker on core1 (the core
+// that writes the log), so they work in every FSM state:
+//   L        text dump (read_log)
+//   Q<ev>    text dump of one event type (hex log_event_id_t) via the log index
+//   X[hex]   binary export, optionally resuming at a hex offset
+void log_export_poll(void);
+
+#endif //PILL_DISPENSER_LOG_EXPORT_H
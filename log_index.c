@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <string.h>
+#include "log_index.h"
+#include "eeprom.h"
+
+_Static_assert(LOG_EV_COUNT <= 32, "event mask is 32 bits");
+_Static_assert(sizeof(log_index_t) <= LOG_INDEX_SLOT_SIZE, "index entry must fit its slot");
+_Static_assert(EEPROM_PAGE_SIZE % LOG_INDEX_SLOT_SIZE == 0, "index entries must not straddle pages");
+_Static_assert(LOG_MAX_ENTRIES % LOG_INDEX_BLOCK == 0, "log must hold whole index blocks");
+_Static_assert(LOG_INDEX_BLOCKS * LOG_INDEX_SLOT_SIZE <= EEPROM_PART_INDEX_SIZE, "index partition too small");
+
+static log_index_t log_index[LOG_INDEX_BLOCKS];
+static log_record_t block_buf[LOG_INDEX_BLOCK];
+
+static uint16_t index_crc(const log_index_t *e) {
+    return crc16((const uint8_t*)e, offsetof(log_index_t, crc));
+}
+
+static void index_reset(log_index_t *e, uint32_t first_seq) {
+    memset(e, 0, sizeof(*e));
+    e->first_seq = first_seq;
+    e->t_min     = UINT32_MAX;
+    e->day_min   = 0xFF;
+}
+
+static void index_account(log_index_t *e, const log_record_t *rec) {
+    if (rec->time < e->t_min) e->t_min = rec->time;
+    if (rec->time > e->t_max) e->t_max = rec->time;
+    if (rec->event < LOG_EV_COUNT) {
+        e->event_mask |= LOG_EV_BIT(rec->event);
+    }
+    if (rec->day > 0) {
+        if (rec->day < e->day_min) e->day_min = rec->day;
+        if (rec->day > e->day_max) e->day_max = rec->day;
+    }
+    e->count++;
+}
+
+static void index_store(int block) {
+    log_index_t *e = &log_index[block];
+    e->crc = index_crc(e);
+    // Waits for the chip: a lost summary would hide its block from log_query()
+    if (eeprom_write_sync(EEPROM_PART_INDEX_ADDR + block * LOG_INDEX_SLOT_SIZE,
+                          (uint8_t*)e, sizeof(*e)) != 0) {
+        printf("[LOG] index write failed, block %d\n", block);
+    }
+}
+
+static int block_of(uint32_t seq) {
+    return (int)((seq / LOG_INDEX_BLOCK) % LOG_INDEX_BLOCKS);
+}
+
+// First seq of the newest block stored in ring block b, -1 if never written
+static int64_t newest_block_seq(int block, uint32_t next_seq) {
+    int64_t first = (int64_t)(next_seq / LOG_MAX_ENTRIES) * LOG_MAX_ENTRIES +
+                    (int64_t)block * LOG_INDEX_BLOCK;
+    if (first >= next_seq) {
+        first -= LOG_MAX_ENTRIES;
+    }
+    return first;
+}
+
+// Read all records of the block starting at first_seq, 0 = ok, -1 = EEPROM error
+static int read_block(uint32_t first_seq) {
+    uint16_t addr = LOG_START_ADDR + (first_seq % LOG_MAX_ENTRIES) * LOG_ENTRY_SIZE;
+    return eeprom_read(addr, (uint8_t*)block_buf, sizeof(block_buf));
+}
+
+static bool record_ok(const log_record_t *rec, uint32_t seq) {
+    return log_record_valid(rec, seq % LOG_MAX_ENTRIES) && rec->seq == seq;
+}
+
+// Summaries are only trusted when they belong to the newest lap of their
+// block, anything else is left unknown and simply gets scanned by queries
+void log_index_load(uint32_t next_seq) {
+    for (int b = 0; b < LOG_INDEX_BLOCKS; b++) {
+        log_index_t *e = &log_index[b];
+        int64_t first = newest_block_seq(b, next_seq);
+        bool ok = false;
+
+        if (first >= 0 && first + LOG_INDEX_BLOCK <= next_seq &&
+            eeprom_read(EEPROM_PART_INDEX_ADDR + b * LOG_INDEX_SLOT_SIZE,
+                        (uint8_t*)e, sizeof(*e)) == 0) {
+            ok = index_crc(e) == e->crc && e->first_seq == (uint32_t)first && e->count > 0;
+        }
+        if (!ok) {
+            index_reset(e, first >= 0 ? (uint32_t)first : 0);
+        }
+    }
+
+    // The block being filled is never on the EEPROM, rebuild it from its records
+    uint32_t first = next_seq - next_seq % LOG_INDEX_BLOCK;
+    log_index_t *cur = &log_index[block_of(first)];
+    index_reset(cur, first);
+    if (first < next_seq && read_block(first) == 0) {
+        for (uint32_t seq = first; seq < next_seq; seq++) {
+            if (record_ok(&block_buf[seq - first], seq)) {
+                index_account(cur, &block_buf[seq - first]);
+            }
+        }
+    }
+}
+
+void log_index_add(const log_record_t *rec) {
+    int block = block_of(rec->seq);
+    uint32_t pos = rec->seq % LOG_INDEX_BLOCK;
+    log_index_t *e = &log_index[block];
+
+    if (pos == 0 || e->first_seq != rec->seq - pos) {
+        index_reset(e, rec->seq - pos);
+    }
+    index_account(e, rec);
+    if (pos == LOG_INDEX_BLOCK - 1) {
+        index_store(block);   // one index write per 16 log records
+    }
+}
+
+static bool summary_matches(const log_index_t *e, const log_query_t *q) {
+    if (q->event_mask && !(e->event_mask & q->event_mask)) return false;
+    if (e->t_max < q->t_from) return false;
+    if (q->t_to && e->t_min > q->t_to) return false;
+    if (q->day && (q->day < e->day_min || q->day > e->day_max)) return false;
+    return true;
+}
+
+static bool record_matches(const log_record_t *rec, const log_query_t *q) {
+    if (q->event_mask && (rec->event >= LOG_EV_COUNT || !(q->event_mask & LOG_EV_BIT(rec->event)))) return false;
+    if (rec->time < q->t_from) return false;
+    if (q->t_to && rec->time > q->t_to) return false;
+    if (q->day && rec->day != q->day) return false;
+    return true;
+}
+
+int log_query(const log_query_t *q, log_query_cb cb, void *ctx) {
+    uint32_t next   = log_next_seq();
+    uint32_t oldest = next > LOG_MAX_ENTRIES ? next - LOG_MAX_ENTRIES : 0;
+    int matches = 0;
+
+    for (uint32_t first = oldest - oldest % LOG_INDEX_BLOCK; first < next; first += LOG_INDEX_BLOCK) {
+        int block = block_of(first);
+        log_index_t *e = &log_index[block];
+        bool known = e->count > 0 && e->first_seq == first;
+
+        if (known && !summary_matches(e, q)) {
+            continue;   // nothing in this block, skip the read
+        }
+        if (read_block(first) != 0) {
+            return -1;
+        }
+
+        // Unknown summary of a complete block in the current lap: rebuild it while we are here
+        bool rebuild = !known && first >= oldest && first + LOG_INDEX_BLOCK <= next;
+        if (rebuild) {
+            index_reset(e, first);
+        }
+        for (uint32_t i = 0; i < LOG_INDEX_BLOCK; i++) {
+            uint32_t seq = first + i;
+            const log_record_t *rec = &block_buf[i];
+            if (seq < oldest || seq >= next || !record_ok(rec, seq)) {
+                continue;
+            }
+            if (rebuild) {
+                index_account(e, rec);
+            }
+            if (record_matches(rec, q)) {
+                matches++;
+                if (cb && !cb(rec, ctx)) {
+                    return matches;
+                }
+            }
+        }
+        if (rebuild && e->count > 0) {
+            index_store(block);
+        }
+    }
+    return matches;
+}
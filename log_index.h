@@ -0,0 +1,48 @@
+#ifndef PILL_DISPENSER_LOG_INDEX_H
+#define PILL_DISPENSER_LOG_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "eeprom.h"
+
+#define LOG_INDEX_BLOCK     16     // log records summarised by one index entry (256 bytes)
+#define LOG_INDEX_SLOT_SIZE 32     // two index entries per EEPROM page
+#define LOG_INDEX_BLOCKS    (LOG_MAX_ENTRIES / LOG_INDEX_BLOCK)
+
+#define LOG_EV_BIT(ev) (1u << (ev))
+
+// Summary of one block of the log ring, kept in RAM and persisted to the
+// index partition once the block is full
+typedef struct {
+    uint32_t first_seq;    // seq of the first record in the block
+    uint32_t t_min;
+    uint32_t t_max;
+    uint32_t event_mask;   // LOG_EV_BIT() of every event in the block
+    uint8_t  day_min;      // over records with a day, 0xFF/0 if none
+    uint8_t  day_max;
+    uint8_t  count;        // records summarised, 0 = unknown
+    uint8_t  reserved;
+    uint16_t crc;
+} log_index_t;
+
+// Match criteria, a zero field matches anything
+typedef struct {
+    uint32_t t_from;       // epoch seconds, inclusive
+    uint32_t t_to;         // 0 = no upper bound
+    uint32_t event_mask;   // LOG_EV_BIT() set
+    uint8_t  day;
+} log_query_t;
+
+// Return false to stop the query early
+typedef bool (*log_query_cb)(const log_record_t *rec, void *ctx);
+
+// Called by the log itself: load the index once the head is known,
+// and account for every record written
+void log_index_load(uint32_t next_seq);
+void log_index_add(const log_record_t *rec);
+
+// Visit matching records oldest first. Only blocks whose summary can match
+// are read from the EEPROM. Returns the number of matches, -1 on EEPROM error.
+int log_query(const log_query_t *q, log_query_cb cb, void *ctx);
+
+#endif //PILL_DISPENSER_LOG_INDEX_H
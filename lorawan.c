@@ -3,6 +3,7 @@
 #include <string.h>
 #include "board_config.h"
 #include "iuart.h"
+#include "io_worker.h"
 
 
 void lorawan_init(void) {
@@ -148,6 +149,6 @@ bool handle_lorawan(void) {
 
 void send_status_to_lorawan(Dispenser *dis, const char *status) {
     if (dis->is_lorawan_connected) {
-        lorawan_send_message(status);
+        io_uplink(status);   // sent from core1, may take seconds
     }
 }
\ No newline at end of file
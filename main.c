@@ -8,22 +8,13 @@
 #include "pill_sensor.h"
 #include "statemachine.h"
 #include "hardware/rtc.h"
+#include "io_worker.h"
 
 // Global module instances
 static Stepper         g_stepper;
 static pillSensorState g_sensor;
 static Dispenser       g_dispenser;
 static datetime_t t;
-// Single global GPIO IRQ callback for RP2040
-static void global_gpio_irq(uint gpio, uint32_t events) {
-    // Stepper index sensor (optical fork)
-    if (gpio == g_stepper.sensor_pin && (events & GPIO_IRQ_EDGE_FALL)) {
-        g_stepper.index_hit = true;
-    }
-
-    // Pill hit sensor (piezo)
-    pill_sensor_handle_irq(&g_sensor, gpio, events);
-}
 
 int main(void) {
     stdio_init_all();
@@ -40,6 +31,10 @@ int main(void) {
         t.sec   = 00;
         rtc_set_datetime(&t);
     }
+    crc16_init(CRC16_DMA_SNIFF);
+    log_init();
+    stats_init();
+    io_worker_start();   // log writes and uplinks run on core1 from here on
     // ---for debug---
      //erase_log();
      //uint8_t zero=0;
@@ -58,18 +53,8 @@ int main(void) {
     printf("Pill sensor initialized. Detection window = %u ms\n",
            g_sensor.pill_fall_time);
 
-    // -------- GPIO IRQ registration (one global callback) --------
-    gpio_set_irq_enabled_with_callback(
-        g_stepper.sensor_pin,
-        GPIO_IRQ_EDGE_FALL,
-        true,
-        global_gpio_irq
-    );
-    gpio_set_irq_enabled(
-        PILL_SENSOR_PIN,
-        GPIO_IRQ_EDGE_FALL,
-        true
-    );
+    // GPIO IRQs: stepper_init() and pill_sensor_init() register their own
+    // handlers in the gpio_irq dispatch table
 
     // -------- State machine initialization --------
     // Example: dispense 7 pills, one pill every 30 seconds
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "board_config.h"
+#include "piezo_adc.h"
+#include "gpio_irq.h"   // gpio_irq_now_us()
+
+typedef struct {
+    int chan[2];
+    uint16_t buf[2][PIEZO_BLOCK];
+    piezo_kernel_t kernel;
+    volatile bool running;
+    piezo_impact_cb cb;
+    void *ctx;
+} piezo_adc_t;
+
+static piezo_adc_t piezo;
+
+static void __not_in_flash_func(piezo_dma_irq)(void) {
+    uint64_t now = gpio_irq_now_us();
+    for (int b = 0; b < 2; b++) {
+        int ch = piezo.chan[b];
+        if (!dma_channel_get_irq1_status(ch)) {
+            continue;
+        }
+        dma_channel_acknowledge_irq1(ch);
+        // The other channel is filling now; re-arm this one for when it chains back
+        dma_channel_set_write_addr(ch, piezo.buf[b], false);
+        if (!piezo.running) {
+            continue;
+        }
+        bool before = piezo.kernel.impacts > 0;
+        piezo_kernel_feed(&piezo.kernel, piezo.buf[b], PIEZO_BLOCK);
+        if (!before && piezo.kernel.onset >= 0 && piezo.cb) {
+            uint64_t t = now - (uint64_t)(PIEZO_BLOCK - piezo.kernel.onset) * PIEZO_SAMPLE_US;
+            piezo.cb(piezo.ctx, t);
+        }
+    }
+}
+
+static void configure_channel(int b, bool trigger) {
+    dma_channel_config c = dma_channel_get_default_config(piezo.chan[b]);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, DREQ_ADC);
+    channel_config_set_chain_to(&c, piezo.chan[b ^ 1]);
+    dma_channel_configure(piezo.chan[b], &c, piezo.buf[b], &adc_hw->fifo, PIEZO_BLOCK, trigger);
+}
+
+void piezo_adc_init(piezo_impact_cb cb, void *ctx) {
+    piezo.cb  = cb;
+    piezo.ctx = ctx;
+    piezo.running = false;
+
+    adc_init();
+    adc_gpio_init(PIEZO_PIN);   // also turns the digital input off
+    adc_select_input(PIEZO_ADC_INPUT);
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv(PIEZO_ADC_CLKDIV);
+
+    piezo.chan[0] = dma_claim_unused_channel(true);
+    piezo.chan[1] = dma_claim_unused_channel(true);
+    dma_channel_set_irq1_enabled(piezo.chan[0], true);
+    dma_channel_set_irq1_enabled(piezo.chan[1], true);
+    irq_set_exclusive_handler(DMA_IRQ_1, piezo_dma_irq);
+    irq_set_enabled(DMA_IRQ_1, true);
+}
+
+// Capture from now until piezo_adc_stop(), e.g. one move plus its detection window
+void piezo_adc_start(void) {
+    piezo_adc_stop();
+    piezo_kernel_reset(&piezo.kernel);
+    configure_channel(1, false);
+    configure_channel(0, true);
+    piezo.running = true;
+    adc_run(true);
+}
+
+void piezo_adc_stop(void) {
+    adc_run(false);
+    piezo.running = false;
+    // ADC stopped first, so neither channel can complete and chain while aborting
+    dma_channel_abort(piezo.chan[0]);
+    dma_channel_abort(piezo.chan[1]);
+    dma_channel_acknowledge_irq1(piezo.chan[0]);
+    dma_channel_acknowledge_irq1(piezo.chan[1]);
+    adc_fifo_drain();
+}
+
+void piezo_adc_arrive(void) {
+    irq_set_enabled(DMA_IRQ_1, false);   // not halfway through a block
+    piezo_kernel_arrive(&piezo.kernel);
+    irq_set_enabled(DMA_IRQ_1, true);
+}
+
+piezo_class_t piezo_adc_result(void) {
+    return piezo_kernel_result(&piezo.kernel);
+}
+
+const piezo_kernel_t *piezo_adc_kernel(void) {
+    return &piezo.kernel;
+}
@@ -0,0 +1,58 @@
+#ifndef PILL_DISPENSER_PIEZO_ADC_H
+#define PILL_DISPENSER_PIEZO_ADC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define PIEZO_ADC_INPUT          1       // PIEZO_PIN, GPIO27 = ADC1
+#define PIEZO_ADC_CLKDIV         959     // 48 MHz / (1 + 959) = 50 kS/s
+#define PIEZO_SAMPLE_US          20
+#define PIEZO_BLOCK              256     // samples per DMA buffer, ~5 ms
+
+// Classifier tuning, in 12-bit ADC counts. Set from recorded waveforms.
+#define PIEZO_IMPACT_THRESH      200     // deviation from baseline that starts an impact
+#define PIEZO_REFRACTORY_SAMPLES 1500    // 30 ms below threshold ends the ringing of one impact
+#define PIEZO_ENERGY_SHIFT       6       // squared deviation >> shift before summing
+#define PIEZO_MULTI_ENERGY       3000000 // ~2x one pill: a single onset above this = pills landing together
+#define PIEZO_BASELINE_SHIFT     6       // DC tracking speed while quiet
+
+typedef enum {
+    PIEZO_NONE = 0,
+    PIEZO_ONE,
+    PIEZO_MULTI
+} piezo_class_t;
+
+// Fixed-point energy/peak kernel (piezo_kernel.c), no hardware access: fed one buffer at a time
+typedef struct {
+    bool     primed;       // baseline taken from the first sample
+    int32_t  baseline_q;   // DC level << PIEZO_BASELINE_SHIFT
+    uint32_t energy;       // sum of scaled squared deviations since reset
+    uint16_t peak;         // largest deviation since reset
+    uint8_t  impacts;      // onsets separated by a quiet gap
+    bool     in_impact;
+    uint16_t quiet;        // samples below threshold inside an impact
+    int      onset;        // sample index of the first onset in the last block, -1 = none
+} piezo_kernel_t;
+
+void piezo_kernel_reset(piezo_kernel_t *k);
+void piezo_kernel_feed(piezo_kernel_t *k, const uint16_t *s, size_t n);
+piezo_class_t piezo_kernel_result(const piezo_kernel_t *k);
+// The wheel reached the hole: drop the energy and peak summed so far, they
+// are motor vibration. An impact still ringing keeps them, it is a pill
+// that landed during the last steps.
+void piezo_kernel_arrive(piezo_kernel_t *k);
+
+// Free-running ADC on the piezo input, DMA ping-pong into two buffers.
+// Each full buffer raises one DMA IRQ that runs the kernel over it, so there
+// is no per-sample interrupt. on_impact runs in that IRQ at the first onset.
+typedef void (*piezo_impact_cb)(void *ctx, uint64_t t_us);
+
+void piezo_adc_init(piezo_impact_cb cb, void *ctx);
+void piezo_adc_start(void);
+void piezo_adc_stop(void);
+void piezo_adc_arrive(void);    // piezo_kernel_arrive() on the running capture
+piezo_class_t piezo_adc_result(void);
+const piezo_kernel_t *piezo_adc_kernel(void);
+
+#endif //PILL_DISPENSER_PIEZO_ADC_H
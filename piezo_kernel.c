@@ -0,0 +1,71 @@
+#include <string.h>
+#include "piezo_adc.h"
+
+void piezo_kernel_reset(piezo_kernel_t *k) {
+    memset(k, 0, sizeof(*k));
+    k->onset = -1;
+}
+
+// Per sample: one subtract, one multiply, a few compares. The baseline only
+// follows the signal while quiet, so the ringing of an impact is not tracked away.
+void piezo_kernel_feed(piezo_kernel_t *k, const uint16_t *s, size_t n) {
+    k->onset = -1;
+    if (n == 0) {
+        return;
+    }
+    if (!k->primed) {
+        k->baseline_q = (int32_t)s[0] << PIEZO_BASELINE_SHIFT;
+        k->primed = true;
+    }
+    int32_t  base   = k->baseline_q;
+    uint32_t energy = k->energy;
+    uint16_t peak   = k->peak;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t d = (int32_t)s[i] - (base >> PIEZO_BASELINE_SHIFT);
+        uint32_t a = (uint32_t)(d < 0 ? -d : d);
+        if (a > peak) {
+            peak = (uint16_t)a;
+        }
+        energy += ((uint32_t)(d * d)) >> PIEZO_ENERGY_SHIFT;
+
+        if (a > PIEZO_IMPACT_THRESH) {
+            if (!k->in_impact) {
+                k->in_impact = true;
+                if (k->impacts < UINT8_MAX) {
+                    k->impacts++;
+                }
+                if (k->onset < 0) {
+                    k->onset = (int)i;
+                }
+            }
+            k->quiet = 0;
+        } else if (k->in_impact) {
+            if (++k->quiet >= PIEZO_REFRACTORY_SAMPLES) {
+                k->in_impact = false;
+            }
+        } else {
+            base += (((int32_t)s[i] << PIEZO_BASELINE_SHIFT) - base) >> PIEZO_BASELINE_SHIFT;
+        }
+    }
+    k->baseline_q = base;
+    k->energy     = energy;
+    k->peak       = peak;
+}
+
+void piezo_kernel_arrive(piezo_kernel_t *k) {
+    if (!k->in_impact) {
+        k->energy = 0;
+        k->peak   = 0;
+    }
+}
+
+piezo_class_t piezo_kernel_result(const piezo_kernel_t *k) {
+    if (k->impacts == 0) {
+        return PIEZO_NONE;
+    }
+    if (k->impacts > 1 || k->energy > PIEZO_MULTI_ENERGY) {
+        return PIEZO_MULTI;
+    }
+    return PIEZO_ONE;
+}
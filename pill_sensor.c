@@ -2,28 +2,61 @@
 #include"pico/stdlib.h"
 #include "pico/time.h"
 #include"pill_sensor.h"
+#include "board_config.h"
+#include "gpio_irq.h"
 #include<math.h>
 #include <time.h>
 #include<stdio.h>
+#include <string.h>
+#include "hardware/sync.h"
+
+// One qualifying edge/impact, from the GPIO IRQ or the ADC DMA IRQ
+static void __not_in_flash_func(note_edge)(void *ctx, uint64_t t_us) {
+    pillSensorState *ptr = ctx;
+    uint32_t head = ptr->edge_head;
+    if (head - ptr->edge_tail < PILL_EDGE_RING) {
+        ptr->edge_us[head % PILL_EDGE_RING] = t_us;
+        __dmb();   // timestamp visible before the new head
+        ptr->edge_head = head + 1;
+    } else {
+        ptr->edge_overruns++;
+    }
+    ptr->hit_flag = true;
+    ptr->last_edge_count++;
+}
 
-void pill_sensor_handle_irq(pillSensorState *ptr, uint gpio, uint32_t events) {
-    if (!ptr) return;
-
-    if (gpio == PILL_SENSOR_PIN && (events & GPIO_IRQ_EDGE_FALL)) {
-        ptr->hit_flag = true;
-        ptr->last_edge_count++;
-
-                // DEBUG: to see the irq work
-        // printf("[IRQ] pill sensor edge, count=%lu\n",
-        //                (unsigned long)ptr->last_edge_count);
+// Registered for PILL_SENSOR_PIN falling edges only
+static void __not_in_flash_func(piezo_edge_irq)(void *ctx, uint gpio, uint32_t events) {
+    (void)gpio;
+    (void)events;
+    note_edge(ctx, gpio_irq_now_us());
 
-    }
+    // DEBUG: to see the irq work
+    // printf("[IRQ] pill sensor edge, count=%lu\n",
+    //                (unsigned long)((pillSensorState*)ctx)->last_edge_count);
 }
 
 void pill_sensor_init(pillSensorState*ptr) {
-        gpio_init(PILL_SENSOR_PIN);
-        gpio_set_dir(PILL_SENSOR_PIN,false);
-        gpio_pull_up(PILL_SENSOR_PIN);
+        ptr->analog = PILL_SENSOR_ANALOG;
+        ptr->last_class = PIEZO_NONE;
+        ptr->last_impacts = 0;
+        if (ptr->analog) {
+            piezo_adc_init(note_edge, ptr);
+        } else {
+            gpio_init(PILL_SENSOR_PIN);
+            gpio_set_dir(PILL_SENSOR_PIN,false);
+            gpio_pull_up(PILL_SENSOR_PIN);
+
+            const gpio_irq_filter_t filter = {
+                .events          = GPIO_IRQ_EDGE_FALL,
+                .min_gap_us      = PIEZO_MIN_GAP_US,
+                .burst_max       = PIEZO_BURST_MAX,
+                .burst_window_us = IRQ_BURST_WINDOW_US,
+                .storm_mask_us   = IRQ_STORM_MASK_US,
+                .hold_off_us     = PIEZO_HOLD_OFF_US,
+            };
+            gpio_irq_register(PILL_SENSOR_PIN, piezo_edge_irq, ptr, &filter);
+        }
         ptr->fall_distance=PILL_FALL_DISTANCE;
         ptr->gravity=GRAVITY;
         ptr->pill_fall_margin=PILL_FALLTIME_MARGIN;
@@ -32,6 +65,12 @@ void pill_sensor_init(pillSensorState*ptr) {
         ptr->pill_fall_time=0;
         ptr->last_hit=false;
         ptr->last_edge_count=0;
+        ptr->edge_head=0;
+        ptr->edge_tail=0;
+        ptr->edge_overruns=0;
+        memset(ptr->hist, 0, sizeof(ptr->hist));
+        ptr->hist_total=0;
+        ptr->late_hits=0;
         pill_sensor_update(ptr);
 }
 
@@ -49,22 +88,133 @@ void pill_sensor_update(pillSensorState*ptr) {
             window_ms = 150;
         }
 
+        ptr->formula_time = window_ms;
         ptr->pill_fall_time = window_ms;
 }
 
-bool pill_sensor_is_ready(pillSensorState *ptr) {
+_Static_assert(PILL_LISTEN_MS > PILL_WINDOW_MAX_MS, "late pills must be seen past the longest window");
+
+// Smallest window that covers PILL_ADAPT_QUANTILE % of the observed pills.
+// Pills after the window are sampled too, so it grows as well as shrinks.
+static void adapt_window(pillSensorState *ptr) {
+    if (ptr->hist_total < PILL_ADAPT_MIN_SAMPLES) {
+        return;
+    }
+    uint32_t need = (ptr->hist_total * PILL_ADAPT_QUANTILE + 99) / 100;
+    uint32_t sum = 0;
+    int bin = 0;
+    for (; bin < PILL_HIST_BINS - 1; bin++) {
+        sum += ptr->hist[bin];
+        if (sum >= need) {
+            break;
+        }
+    }
+    uint32_t window_ms = (uint32_t)(bin + 1) * PILL_HIST_BIN_MS + PILL_ADAPT_MARGIN_MS;
+    if (window_ms < PILL_WINDOW_MIN_MS) {
+        window_ms = PILL_WINDOW_MIN_MS;
+    }
+    if (window_ms > PILL_WINDOW_MAX_MS) {
+        window_ms = PILL_WINDOW_MAX_MS;
+    }
+    if (window_ms != ptr->pill_fall_time) {
+        printf("[PILL] window %lu -> %lu ms (%lu pills)\n", (unsigned long)ptr->pill_fall_time,
+               (unsigned long)window_ms, (unsigned long)ptr->hist_total);
+        ptr->pill_fall_time = window_ms;
+    }
+}
+
+static void record_latency(pillSensorState *ptr, int64_t latency_us) {
+    int bin = 0;
+    if (latency_us > 0) {
+        // pills landing during the last steps count as zero latency
+        int64_t b = latency_us / (PILL_HIST_BIN_MS * 1000);
+        bin = b < PILL_HIST_BINS - 1 ? (int)b : PILL_HIST_BINS - 1;
+    }
+    ptr->hist[bin]++;
+    if (++ptr->hist_total >= PILL_HIST_DECAY_AT) {
+        ptr->hist_total = 0;
+        for (int i = 0; i < PILL_HIST_BINS; i++) {
+            ptr->hist[i] /= 2;
+            ptr->hist_total += ptr->hist[i];
+        }
+    }
+    adapt_window(ptr);
+}
+
+// Empty the edge ring; the first edge of this pill goes into the histogram
+static void drain_edges(pillSensorState *ptr, bool sample) {
+    uint32_t head = ptr->edge_head;
+    __dmb();
+    if (sample && head != ptr->edge_tail) {
+        uint64_t first = ptr->edge_us[ptr->edge_tail % PILL_EDGE_RING];
+        if (first > to_us_since_boot(ptr->window_end)) {
+            ptr->late_hits++;
+            printf("[PILL] late pill, %lu ms after the hole\n",
+                   (unsigned long)((first - to_us_since_boot(ptr->window_start)) / 1000));
+        }
+        record_latency(ptr, (int64_t)(first - to_us_since_boot(ptr->window_start)));
+    }
+    ptr->edge_tail = head;
+}
+
+void pill_sensor_arm(pillSensorState *ptr, absolute_time_t hole_time) {
+    ptr->window_start = hole_time;
+    ptr->window_end = delayed_by_ms(hole_time, ptr->pill_fall_time);
+    if (ptr->analog) {
+        piezo_adc_arrive();   // the capture ran through the move, its hum is no pill
+    }
+}
+
+bool pill_sensor_wait(pillSensorState *ptr) {
     // We do NOT clear last_edge_count here, because edges may have
     // happened while the motor was rotating before this call.
     ptr->last_hit = false;
 
-    // Wait extra time after the motor finishes, so late hits are captured.
-    // During this sleep, the IRQ handler keeps incrementing last_edge_count.
-    sleep_ms(ptr->pill_fall_time);
+    // The piezo IRQ wakes the core, so the first edge ends the wait
+    // instead of the full window. Without one the wait runs past window_end:
+    // a pill the window would have missed is still dispensed, and only
+    // once its latency is sampled can the window grow back.
+    absolute_time_t listen_end = delayed_by_ms(ptr->window_start, PILL_LISTEN_MS);
+    if (to_us_since_boot(listen_end) < to_us_since_boot(ptr->window_end)) {
+        listen_end = ptr->window_end;
+    }
+    while (!ptr->hit_flag && ptr->last_edge_count == 0) {
+        if (best_effort_wfe_or_timeout(listen_end)) {
+            break;   // no pill, not even a late one
+        }
+    }
+
+    if (ptr->analog) {
+        // A second pill only counts once the ringing of the first has died
+        // down, so keep sampling to the end of the window, and at least the
+        // refractory time (plus one block for its DMA IRQ) past the first onset
+        absolute_time_t until = ptr->window_end;
+        uint32_t head = ptr->edge_head;
+        __dmb();
+        if (head != ptr->edge_tail) {
+            uint64_t settle = ptr->edge_us[ptr->edge_tail % PILL_EDGE_RING] +
+                              (uint64_t)(PIEZO_REFRACTORY_SAMPLES + PIEZO_BLOCK) * PIEZO_SAMPLE_US;
+            if (to_us_since_boot(until) < settle) {
+                until = from_us_since_boot(settle);
+            }
+        }
+        while (!best_effort_wfe_or_timeout(until)) {
+        }
+        piezo_adc_stop();
+        const piezo_kernel_t *k = piezo_adc_kernel();
+        ptr->last_class   = piezo_adc_result();
+        ptr->last_impacts = k->impacts;
+        if (ptr->last_class == PIEZO_MULTI) {
+            printf("[PILL] several pills: %u impacts, energy %lu, peak %u\n",
+                   k->impacts, (unsigned long)k->energy, k->peak);
+        }
+    }
 
     // If at least one edge was seen since the last check, we treat it as a hit.
     if (ptr->last_edge_count > 0 || ptr->hit_flag) {
         ptr->last_hit = true;
     }
+    drain_edges(ptr, ptr->last_hit);
 
     // Reset flags/counters for the next pill
     ptr->hit_flag        = false;
@@ -73,9 +223,32 @@ bool pill_sensor_is_ready(pillSensorState *ptr) {
     return ptr->last_hit;
 }
 
+// Window measured from now
+bool pill_sensor_is_ready(pillSensorState *ptr) {
+    pill_sensor_arm(ptr, get_absolute_time());
+    return pill_sensor_wait(ptr);
+}
+
 void pill_sensor_reset(pillSensorState *ptr){
     if(!ptr) return ;
     ptr->hit_flag=false;
     ptr->last_edge_count=0;
     ptr->last_hit=false;
+    drain_edges(ptr, false);   // late edges of the previous pill are not a latency sample
+    if (ptr->analog) {
+        piezo_adc_start();     // pills may land during the move
+    }
+}
+
+void pill_sensor_print_stats(const pillSensorState *ptr) {
+    printf("[PILL] window %lu ms (formula %lu ms), %lu pills, %lu late, %lu ring overruns\n",
+           (unsigned long)ptr->pill_fall_time, (unsigned long)ptr->formula_time,
+           (unsigned long)ptr->hist_total, (unsigned long)ptr->late_hits,
+           (unsigned long)ptr->edge_overruns);
+    for (int i = 0; i < PILL_HIST_BINS; i++) {
+        if (ptr->hist[i]) {
+            printf("[PILL] %3d ms%s: %u\n", i * PILL_HIST_BIN_MS,
+                   i == PILL_HIST_BINS - 1 ? "+" : "", ptr->hist[i]);
+        }
+    }
 }
@@ -9,9 +9,24 @@
 #define GRAVITY 9.8f
 #define PILL_FALLTIME_MARGIN 0.5f
 #define MOTOR_STOP_EXTRA_MS    80
+#define PILL_SENSOR_ANALOG     0      // 1 = sample the piezo by ADC/DMA and count impacts
+
+// Edge capture and adaptive window
+#define PILL_EDGE_RING         16     // edge timestamps, power of two
+#define PILL_HIST_BINS         48     // fall latency histogram, last bin = overflow
+#define PILL_HIST_BIN_MS       10
+#define PILL_HIST_DECAY_AT     256    // halve all bins at this many samples, old pills fade out
+#define PILL_ADAPT_MIN_SAMPLES 8      // keep the formula window until this many pills were seen
+#define PILL_ADAPT_QUANTILE    98     // percent of observed pills the window must cover
+#define PILL_ADAPT_MARGIN_MS   40
+#define PILL_WINDOW_MIN_MS     100
+#define PILL_WINDOW_MAX_MS     400
+#define PILL_LISTEN_MS         (PILL_HIST_BINS * PILL_HIST_BIN_MS)   // no pill in the window: wait this long for a late one
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "pico/time.h"
+#include "piezo_adc.h"
 
 typedef struct {
     float fall_distance ;
@@ -21,7 +36,25 @@ typedef struct {
     uint32_t pill_fall_time ;
     volatile bool hit_flag;
     bool last_hit;
-    uint32_t last_edge_count;
+    volatile uint32_t last_edge_count;
+    absolute_time_t window_start; // wheel reached the hole
+    absolute_time_t window_end;   // detection window closes here
+
+    // edge timestamps, IRQ writes head, FSM reads tail
+    uint64_t edge_us[PILL_EDGE_RING];
+    volatile uint32_t edge_head;
+    uint32_t edge_tail;
+    volatile uint32_t edge_overruns;
+
+    // latency of the first edge after the hole, relative to window_start
+    uint16_t hist[PILL_HIST_BINS];
+    uint32_t hist_total;
+    uint32_t formula_time;        // window from the free-fall formula, used until adapted
+    uint32_t late_hits;           // pills after window_end, caught by listening on
+
+    bool analog;                  // impacts come from the ADC classifier, not the edge IRQ
+    piezo_class_t last_class;     // analog mode: none / one / several pills last window
+    uint8_t last_impacts;         // analog mode: impacts counted in that window
 }pillSensorState;
 
 void pill_sensor_init(pillSensorState*ptr);
@@ -30,10 +63,21 @@ void pill_sensor_update(pillSensorState*ptr);
 
 bool pill_sensor_is_ready(pillSensorState*ptr);
 
-void pill_sensor_handle_irq(pillSensorState*ptr,uint gpio, uint32_t events);
+// Open the detection window at the moment the wheel reached the hole
+void pill_sensor_arm(pillSensorState*ptr, absolute_time_t hole_time);
+
+// Sleep (WFE) until an edge is seen; true on a hit. With none by the end of
+// the window it listens on to PILL_LISTEN_MS after the hole, so late pills
+// still count and reach the latency histogram.
+// In analog mode the capture runs on to classify the whole window, the
+// result is in last_class / last_impacts.
+bool pill_sensor_wait(pillSensorState*ptr);
 
 void pill_sensor_reset(pillSensorState*ptr);
 
+// Dump the latency histogram and the current window
+void pill_sensor_print_stats(const pillSensorState*ptr);
+
 
 
 
@@ -7,6 +7,8 @@
 #include"board_config.h"
 #include "eeprom.h"
 #include "lorawan.h"
+#include "gpio_irq.h"
+#include "io_worker.h"
 #include "hardware/rtc.h"
 
 //==============================================================================================
@@ -39,34 +41,27 @@ bool restore_from_eeprom(Dispenser* dis) {
         dis->motor->in_motion = (s.in_motion != 0);
         dis->motor->calibrated = (s.calibrated != 0);
         dis->motor->step_index = s.step_index;
+        dis->motor->position = s.position;
+        dis->motor->target = s.target;
         dis->motor->slot_offset_steps = SLOT_OFFSET_STEPS;
     }
     printf(
-        "[FSM] Restored from EEPROM: state=%u, pills_left=%u, steps=%u, in_motion=%u,calibrate=%u,step_index=%u,slot_done=%u\n",
-        s.state, s.pills_left, s.current_steps_slot, s.in_motion, s.calibrated, s.step_index, s.slot_done);
+        "[FSM] Restored from EEPROM: state=%u, pills_left=%u, position=%u, in_motion=%u,calibrate=%u,step_index=%u,slot_done=%u\n",
+        s.state, s.pills_left, s.position, s.in_motion, s.calibrated, s.step_index, s.slot_done);
     return true;
 }
 
-// Format current RTC time as "YYYY-MM-DD HH:MM:SS"
-static void format_timestamp(char* buf, size_t len) {
-    datetime_t t;
-    rtc_get_datetime(&t);
-
-    // Example: "2025-12-07 13:42:05"
-    snprintf(buf, len,
-             "%04d-%02d-%02d %02d:%02d:%02d",
-             t.year, t.month, t.day,
-             t.hour, t.min, t.sec);
-}
-
-// Log + LoRa helper: add timestamp + (opt) day index
-static void log_event(Dispenser* dis, const char* event) {
-    char ts[20];
-    char line[LOG_STRING_MAX_LEN];
-
-    format_timestamp(ts, sizeof(ts));
-
+// Log + LoRa helper: binary record with timestamp + (opt) day index,
+// rendered to text only for the LoRa uplink
+static void log_event_arg(Dispenser* dis, log_event_id_t event, uint16_t arg) {
     if (dis) {
+        log_record_t rec = {0};
+        rec.time       = log_time_now();
+        rec.event      = (uint8_t)event;
+        rec.arg        = arg;
+        rec.pills_left = (uint8_t)dis->pills_left;
+        rec.state      = (uint8_t)dis->state;
+
         // Only show "Day X" AFTER dispensing has started
         bool day_started =
             (dis->state == ST_DISPENSING);
@@ -74,18 +69,32 @@ static void log_event(Dispenser* dis, const char* event) {
         if (day_started && dis->slot_done > 0) {
             uint8_t day = dis->slot_done;
             if (day > PILL_NUMS) day = (uint8_t)(PILL_NUMS - dis->pills_left); // Cap at max
-            snprintf(line, sizeof(line), "%s Day %u %s", ts, day, event);
-        }
-        else {
-            snprintf(line, sizeof(line), "%s %s", ts, event);
+            rec.day = day;
         }
 
-        // 1) Store in EEPROM log
-        write_log(line);
+        // Store in the EEPROM log and send over LoRaWAN if connected,
+        // both on core1 so the FSM carries on at once
+        io_log(&rec, dis->is_lorawan_connected);
+    }
+}
 
-        // 2) Send over LoRaWAN if connected
-        if (dis->is_lorawan_connected) {
-            send_status_to_lorawan(dis, line);
+static void log_event(Dispenser* dis, log_event_id_t event) {
+    log_event_arg(dis, event, 0);
+}
+
+// Report what the index checks of the last moves found; a lost position is
+// re-synced on the spot so the rest of the cycle still lines up
+static void check_wheel(Dispenser* dis, int slot) {
+    int32_t error = 0;
+    motion_slip_t slip = stepper_take_slip(dis->motor, &error);
+    if (slip == MOTION_SLIP_CORRECTED) {
+        printf("[FSM] Step slip of %ld corrected at the index\n", (long)error);
+        log_event_arg(dis, LOG_EV_STEP_SLIP, (uint16_t)(int16_t)error);
+    } else if (slip == MOTION_SLIP_LOST) {
+        printf("[FSM] Wheel position lost (index error %ld), resync\n", (long)error);
+        log_event_arg(dis, LOG_EV_INDEX_LOST, (uint16_t)(int16_t)error);
+        if (!stepper_resync(dis->motor, dis, slot)) {
+            dis->motor->calibrated = false;
         }
     }
 }
@@ -139,20 +148,18 @@ void statemachine_step(Dispenser* dis) {
 
     case ST_LORA_CONNECT: {
         printf("[FSM] Connecting to LoRaWAN...\n");
-        lorawan_init();
-
-        bool lora_connected = handle_lorawan();
+        // on core1 like every later uplink, see io_lora_connect()
+        bool lora_connected = io_lora_connect();
 
         if (lora_connected) {
             printf("[FSM] LORA connection is done!!!\n");
-            lorawan_send_message("Group 8 LoraWan Connected!");
             dis->is_lorawan_connected = true;
-            log_event(dis, "BOOT DONE LORA OK");
+            log_event(dis, LOG_EV_BOOT_LORA_OK);
         }
         else {
             printf("Can't connect to LoRaWan. Continue to run without!\n");
             dis->is_lorawan_connected = false;
-            log_event(dis, "BOOT DONE LORA FAIL");
+            log_event(dis, LOG_EV_BOOT_LORA_FAIL);
         }
         dis->state = ST_CHECK_EEPROM;
         break;
@@ -167,7 +174,7 @@ void statemachine_step(Dispenser* dis) {
         if (!ok) {
             //no valid EEPROM => fresh boot: go to wait for calib
             printf("[FSM] No valid EEPROM data -> fresh boot.\n");
-            log_event(dis, "FRESH BOOT");
+            log_event(dis, LOG_EV_FRESH_BOOT);
             dis->state = ST_WAIT_CALIBRATION;
             break;
         }
@@ -193,14 +200,15 @@ void statemachine_step(Dispenser* dis) {
             // motor was moving & pill hasn't fallen yet
             // need to re-attempt this slot
             printf("[FSM] -> ST_RECOVERY (will retry current slot)\n");
-            log_event(dis, "POWER LOSS DURING MOVEMENT");
+            log_event(dis, LOG_EV_POWER_LOSS_MOVING);
+            stats_add(STAT_POWER_LOSSES);
             dis->state = ST_RECOVERY;
             break;
         }
         // 2. no recovery needed: check calibration status
         if (!dis->motor || !dis->motor->calibrated) {
             printf("[FSM] Motor not calibrated -> ST_WAIT_CALIBRATION\n");
-            log_event(dis, "MOTOR NOT CALIBRATED");
+            log_event(dis, LOG_EV_NOT_CALIBRATED);
             dis->state = ST_WAIT_CALIBRATION;
             break;
         }
@@ -209,7 +217,7 @@ void statemachine_step(Dispenser* dis) {
             // Resume dispensing - set next dispense time
             dis->next_dispense_time = make_timeout_time_ms(dis->interval_ms);
             printf("[FSM] Resuming dispensing, pills_left=%u\n", dis->pills_left);
-            log_event(dis, "RESUME DISPENSING");
+            log_event(dis, LOG_EV_RESUME_DISPENSING);
             dis->state = ST_DISPENSING;
         }
         else {
@@ -235,14 +243,21 @@ void statemachine_step(Dispenser* dis) {
 
     case ST_CALIBRATION:
         if (dis->motor) {
-            printf("[FSM] Calibrating motor...\n");
-            stepper_calibrate(dis->motor, dis);
+            state_begin();
             dis->motor->slot_offset_steps = SLOT_OFFSET_STEPS;
-            stepper_apply_slot_offset(dis->motor);
+            // Slot positions do not drift, so a wheel that finds the index
+            // where it expects it skips the full calibration
+            if (!stepper_rehome(dis->motor, dis)) {
+                printf("[FSM] Calibrating motor...\n");
+                stepper_calibrate(dis->motor, dis);
+                dis->motor->slot_offset_steps = SLOT_OFFSET_STEPS;
+                stepper_apply_slot_offset(dis->motor);
+            }
 
             if (!dis->motor->calibrated) {
                 printf("[FSM] Calibration failed.Back to WAIT_CALIBRATION.\n");
-                log_event(dis, "CALIBRATED FAIL");
+                state_commit();
+                log_event(dis, LOG_EV_CALIBRATION_FAIL);
                 dis->state = ST_WAIT_CALIBRATION;
                 break;
             }
@@ -251,7 +266,8 @@ void statemachine_step(Dispenser* dis) {
 
 
             save_sm_state(dis);
-            log_event(dis, "CALIBRATION DONE");
+            state_commit();
+            log_event(dis, LOG_EV_CALIBRATION_DONE);
         }
         dis->state = ST_WAIT_DISPENSING;
         break;
@@ -273,7 +289,14 @@ void statemachine_step(Dispenser* dis) {
     case ST_DISPENSING: {
         if (dis->pills_left == 0) {
             printf("[FSM] Dispensing Finish.\n");
-            log_event(dis, "DISPENSING FINISH");
+            log_event(dis, LOG_EV_DISPENSING_FINISH);
+            if (dis->sensor) {
+                pill_sensor_print_stats(dis->sensor);
+            }
+            gpio_irq_print_stats();
+            io_print_stats();
+            eeprom_print_stats();
+            stats_print();
             dis->state = ST_FINISHED;
             break;
         }
@@ -284,19 +307,32 @@ void statemachine_step(Dispenser* dis) {
 
             printf("[FSM] Attempting slot %u (completed=%u, pills_left=%u)\n",
                    current_slot_attempt, dis->slot_done, dis->pills_left);
+            // in_motion, pills_left and slot_done of this attempt go out as one record;
+            // only the in_motion flag is flushed early, before the wheel moves
+            state_begin();
+
             // 1)reset the pill_sensor flag 
             if (dis->sensor){
                 pill_sensor_reset(dis->sensor);
             }
-            // 2) Rotate wheel by one slot
-            if (dis->motor) {
-                stepper_step_one_slot(dis->motor, dis);
+            // 2) Rotate wheel by one slot, the timer IRQ steps while we service stdio
+            if (dis->motor && stepper_start_one_slot(dis->motor, dis)) {
+                while (stepper_busy(dis->motor)) {
+                    stepper_poll(dis->motor, dis);
+                    tight_loop_contents();
+                }
+                stepper_finish_slot(dis->motor, dis);
+                check_wheel(dis, current_slot_attempt);
             }
 
-            // 3) Wait within the pre-computed time window for a piezo hit
+            // 3) Wait for a piezo hit, at most the pre-computed window after
+            //    the wheel reached the hole; ends early on the first edge
+            //    unless the ADC classifier needs the whole window
             bool hit = false;
             if (dis->sensor) {
-                hit = pill_sensor_is_ready(dis->sensor);
+                pill_sensor_arm(dis->sensor, dis->motor ? stepper_arrival_time(dis->motor)
+                                                        : get_absolute_time());
+                hit = pill_sensor_wait(dis->sensor);
             }
 
             if (hit) {
@@ -309,7 +345,14 @@ void statemachine_step(Dispenser* dis) {
                 printf("[FSM] PILL DETECTED. completed_slots=%u, total_pills=%lu, left=%u\n",
                        dis->slot_done, (unsigned long)dis->total_dispense_count,
                        dis->pills_left);
-                log_event(dis, "DISPENSE OK");
+                log_event(dis, LOG_EV_DISPENSE_OK);
+                stats_add(STAT_PILLS_OK);
+                if (dis->sensor->analog && dis->sensor->last_class == PIEZO_MULTI) {
+                    // still one slot and one day; the log tells the user to check the dose
+                    printf("[FSM] MORE THAN ONE PILL (%u impacts)\n", dis->sensor->last_impacts);
+                    log_event_arg(dis, LOG_EV_DISPENSE_MULTI, dis->sensor->last_impacts);
+                    stats_add(STAT_PILLS_MULTI);
+                }
                 //dis->slot_done = dis->total_dispense_count;
             }
             else {
@@ -322,11 +365,13 @@ void statemachine_step(Dispenser* dis) {
                 printf("[FSM] NO PILL. completed_slots=%u, failed=%lu, left=%u\n",
                        dis->slot_done, (unsigned long)dis->failed_dispense_count,
                        dis->pills_left);
-                log_event(dis, "DISPENSE FAIL NO PILLS");
+                log_event(dis, LOG_EV_DISPENSE_FAIL);
+                stats_add(STAT_PILLS_FAILED);
                 //dis->slot_done = (dis->slot_done + 1) % PILL_NUMS;
                 led_blink(dis, 5);
             }
             save_sm_state(dis);
+            state_commit();
             // Schedule next dispensing time
             dis->next_dispense_time = delayed_by_ms(dis->next_dispense_time, dis->interval_ms);
         }
@@ -354,12 +399,17 @@ void statemachine_step(Dispenser* dis) {
 
         printf("[FSM] Recovering: %u slots completed, will retry slot %u\n",
                dis->slot_done, dis->slot_done + 1);
-        // rewind partial slot and recalibrate (inside stepper_recovery)
+        // shortest move back to the last completed slot boundary (inside stepper_recovery)
         stepper_recovery(dis->motor, dis);
+        check_wheel(dis, dis->slot_done);
+        if (!dis->motor->calibrated) {
+            dis->state = ST_WAIT_CALIBRATION;
+            break;
+        }
 
         printf("[FSM] Recovery done. At end of slot %u, will retry slot %u\n",
                dis->slot_done, dis->slot_done + 1);
-        log_event(dis, "RECOVERY DONE");
+        log_event(dis, LOG_EV_RECOVERY_DONE);
 
         if (dis->pills_left > 0) {
             // Resume dispensing from current position
@@ -379,10 +429,11 @@ void statemachine_step(Dispenser* dis) {
 
     case ST_FINISHED:
     
-        log_event(dis, "CYCLE COMPLETE");
+        log_event(dis, LOG_EV_CYCLE_COMPLETE);
+        stats_add(STAT_CYCLES);
+        stats_save();
 
-        // Reset for next cycle
-        dis->motor->calibrated = false;
+        // Reset for next cycle; calibration is kept, ST_CALIBRATION re-homes
         dis->slot_done = 0; //reset slot counter
         dis->pills_left = PILL_NUMS;
         dis->total_dispense_count = 0;
@@ -1,53 +1,100 @@
 #include "stepper.h"
+#include "stepper_motion.h"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include "eeprom.h"
+#include "gpio_irq.h"
 
-#define STEP_DELAY_MS      2
 #define CALIB_REV_COUNT    3
 #define MIN_STEPS_VALID    50      // Minimum steps between index hits to be considered a full revolution
 #define MAX_STEPS_GUARD    10000   // Safety upper bound to avoid infinite loops
+#define CALIB_BACKOFF_STEPS 16     // back-off after the coarse seek, before the fine approach
+#define CALIB_CHECK_WINDOW  64     // check rev runs slow from this many steps before the expected index
+#define CALIB_TOLERANCE     8      // max difference to the stored steps_per_rev, in half-steps
+
+// Blocking move on top of the timer-driven engine; returns the steps taken.
+// *stopped is set when a stop condition ended the move before `steps`.
+static int32_t move(Stepper *ptr, int dir, int32_t steps, uint32_t flags, bool *stopped) {
+    if (motion_start(ptr, dir, steps, flags, NULL, NULL) != 0) {
+        if (stopped) *stopped = false;
+        return 0;
+    }
+    return motion_wait(stopped);
+}
+
+// Steps done at which stepper_poll() saves the position next, set for
+// every move that is polled
+static int32_t next_checkpoint;
+
+// Asynchronous move with position checkpoints, see POS_CHECKPOINT_STEPS
+static int start_checkpointed(Stepper *ptr, int dir, int32_t steps, uint32_t flags) {
+    next_checkpoint = steps < 2 * POS_CHECKPOINT_STEPS ? steps / 2 : POS_CHECKPOINT_STEPS;
+    return motion_start(ptr, dir, steps, flags, NULL, NULL);
+}
 
-// Half-step sequence (LSB -> pins[0])
-static const uint8_t half_steps[8][4] = {
-    {1, 0, 0, 0},
-    {1, 1, 0, 0},
-    {0, 1, 0, 0},
-    {0, 1, 1, 0},
-    {0, 0, 1, 0},
-    {0, 0, 1, 1},
-    {0, 0, 0, 1},
-    {1, 0, 0, 1}
-};
+// Drive mode for long travel (coarse seek, check rev, recovery); slot moves,
+// the fine approach and the revolution measurement stay in half-steps
+static uint32_t travel_mode = MOTION_MODE_FULL;
+
+void stepper_set_travel_mode(uint32_t mode) {
+    travel_mode = mode & (MOTION_MODE_FULL | MOTION_MODE_WAVE);
+}
+
+static int wrap_position(Stepper *ptr, int pos) {
+    if (ptr->steps_per_rev <= 0) return pos;
+    pos %= ptr->steps_per_rev;
+    return pos < 0 ? pos + ptr->steps_per_rev : pos;
+}
 
-// Single half-step; dir = +1 for CW, -1 for CCW
-static void step(Stepper *ptr, int dir) {
-    ptr->step_index = (ptr->step_index + dir + 8) % 8;
+static void set_steps_per_rev(Stepper *ptr, int steps_per_rev) {
+    ptr->steps_per_rev  = steps_per_rev;
+    ptr->slot_pitch_q16 = ((uint32_t)steps_per_rev << 16) / WHEEL_SLOTS;
+}
 
-    for (int i = 0; i < 4; i++) {
-        gpio_put(ptr->pins[i], half_steps[ptr->step_index][i]);
+// Load the stored steps_per_rev after a reboot; false if never measured
+static bool ensure_steps_per_rev(Stepper *ptr) {
+    config_record_t cfg;
+    if (ptr->steps_per_rev > 0) {
+        return true;
+    }
+    if (load_config(&cfg) != 0 || cfg.steps_per_rev <= 0) {
+        return false;
     }
+    set_steps_per_rev(ptr, cfg.steps_per_rev);
+    return true;
+}
+
+// Boundary of wheel slot k. The fractional pitch accumulates in k * pitch
+// and is rounded once per slot, so the remainder steps of steps_per_rev are
+// spread over the slots and slot WHEEL_SLOTS lands exactly on slot 0 again.
+int stepper_slot_position(Stepper *ptr, int slot) {
+    uint32_t frac = (uint32_t)(((uint64_t)slot * ptr->slot_pitch_q16 + 0x8000u) >> 16);
+    return wrap_position(ptr, ptr->slot_offset_steps + (int)frac);
+}
 
-    sleep_ms(STEP_DELAY_MS);
+// Nearest slot boundary to the current position
+static int current_slot(Stepper *ptr) {
+    int rel = wrap_position(ptr, ptr->position - ptr->slot_offset_steps);
+    return ((rel * WHEEL_SLOTS + ptr->steps_per_rev / 2) / ptr->steps_per_rev) % WHEEL_SLOTS;
 }
 
 // Turn off the motor (all coils off)
 static void motor_off(Stepper *ptr) {
-    (void)ptr; // Currently unused; keeps the compiler happy
-    for (int i = 0; i < 4; i++) {
-        gpio_put(ptr->pins[i], 0);
-    }
+    motion_release(ptr);
+}
+
+// Opto fork falling edge: the index gap starts
+static void __not_in_flash_func(index_edge_irq)(void *ctx, uint gpio, uint32_t events) {
+    (void)gpio;
+    (void)events;
+    ((Stepper*)ctx)->index_hit = true;
 }
 
 void stepper_init(Stepper *ptr) {
-    // Configure coil GPIOs
-    for (int i = 0; i < 4; i++) {
-        gpio_init(ptr->pins[i]);
-        gpio_set_dir(ptr->pins[i], GPIO_OUT);
-        gpio_put(ptr->pins[i], 0);
-    }
+    // Coil pins are set up as PWM outputs by motion_init() below
 
     // Configure optical sensor GPIO
     gpio_init(ptr->sensor_pin);
@@ -55,7 +102,7 @@ void stepper_init(Stepper *ptr) {
     gpio_pull_up(ptr->sensor_pin);   // Normal = HIGH, index gap = LOW
 
     ptr->step_index        = 0;
-    ptr->steps_per_rev     = 0;
+    set_steps_per_rev(ptr, 0);
     ptr->calibrated        = false;
     ptr->index_hit         = false;
     ptr->slot_offset_steps = 0;
@@ -63,83 +110,153 @@ void stepper_init(Stepper *ptr) {
     // For power-loss recovery
 
     ptr->in_motion          = false;
+
+    motion_init(ptr);
+
+    const gpio_irq_filter_t filter = {
+        .events          = GPIO_IRQ_EDGE_FALL,
+        .min_gap_us      = OPTO_MIN_GAP_US,
+        .burst_max       = OPTO_BURST_MAX,
+        .burst_window_us = IRQ_BURST_WINDOW_US,
+        .storm_mask_us   = IRQ_STORM_MASK_US,
+    };
+    gpio_irq_register(ptr->sensor_pin, index_edge_irq, ptr, &filter);
 }
 
 static void stepper_lock_phase(Stepper *ptr) {
     // Output the logic levels based on the current step_index
-    for (int i = 0; i < 4; i++) {
-        gpio_put(ptr->pins[i], half_steps[ptr->step_index][i]);
-    }
+    motion_hold(ptr);
     // Short delay to allow the magnetic field to stabilize the rotor
     sleep_ms(20);
 }
 
 
-void stepper_calibrate(Stepper *ptr,Dispenser*dis) {
-    printf("Calibrating...\n");
+// Coarse seek at cruise speed onto the opto-fork edge, back off, then a slow
+// fine approach so the edge is found at the same resolution as before.
+// Ends on the first step inside the index gap.
+static bool seek_index(Stepper *ptr) {
+    bool stopped;
 
-    ptr->calibrated    = false;
-    ptr->steps_per_rev = 0;
-    ptr->index_hit     = false;
-    save_sm_state(dis);
-    // 1) Make sure we are not starting inside the index gap
+    // Make sure we are not starting inside the index gap
     if (gpio_get(ptr->sensor_pin) == 0) {
-        int guard = 0;
-        while (gpio_get(ptr->sensor_pin) == 0) {
-            step(ptr, +1);
-            if (++guard > MAX_STEPS_GUARD) {
-                printf("Error: stuck in index gap.\n");
-                motor_off(ptr);
-                return;
-            }
+        move(ptr, +1, MAX_STEPS_GUARD, MOTION_STOP_SENSOR, &stopped);
+        if (!stopped) {
+            printf("Error: stuck in index gap.\n");
+            return false;
         }
     }
 
-    // 2) Find the first index edge (sync point, not counted as a full revolution)
-    int guard = 0;
-    ptr->index_hit = false;
-    while (!ptr->index_hit) {
-        step(ptr, +1);
-        if (++guard > MAX_STEPS_GUARD) {
-            printf("Error: index not detected. Check sensor.\n");
-            motor_off(ptr);
-            return;
-        }
+    move(ptr, +1, MAX_STEPS_GUARD, MOTION_RAMP | MOTION_STOP_INDEX | travel_mode, &stopped);
+    if (!stopped) {
+        printf("Error: index not detected. Check sensor.\n");
+        return false;
+    }
+
+    // Back out of the gap (it may have been overshot at speed) plus a margin
+    if (gpio_get(ptr->sensor_pin) == 0) {
+        move(ptr, -1, MAX_STEPS_GUARD, MOTION_STOP_SENSOR, &stopped);
+    }
+    move(ptr, -1, CALIB_BACKOFF_STEPS, 0, NULL);
+
+    // Normally a few steps; a full slow turn if the coarse seek skipped the whole gap
+    move(ptr, +1, MAX_STEPS_GUARD, MOTION_STOP_INDEX, &stopped);
+    if (!stopped) {
+        printf("Error: index lost during fine approach.\n");
+        return false;
     }
-    ptr->index_hit = false;
+    return true;
+}
 
-    // 3) Measure several full revolutions (index→index)
+// Full measurement from an index edge: CALIB_REV_COUNT revolutions at start speed.
+// Returns the average steps_per_rev, 0 on error.
+static int measure_steps_per_rev(Stepper *ptr) {
     int rev_done          = 0;
     int total_steps       = 0;
     int steps_since_index = 0;
+    bool stopped;
 
     while (rev_done < CALIB_REV_COUNT) {
-        step(ptr, +1);
-        steps_since_index++;
-
-        if (steps_since_index > MAX_STEPS_GUARD) {
+        steps_since_index += move(ptr, +1, MAX_STEPS_GUARD - steps_since_index,
+                                  MOTION_STOP_INDEX, &stopped);
+        if (!stopped) {
             printf("Error: no index within expected range.\n");
+            return 0;
+        }
+
+        if (steps_since_index >= MIN_STEPS_VALID) {
+            rev_done++;
+            total_steps += steps_since_index;
+            printf("Rev %d: %d steps\n", rev_done, steps_since_index);
+            steps_since_index = 0;
+        } else {
+            // Too short; treat as noise/bounce
+            steps_since_index = 0;
+        }
+    }
+    return total_steps / CALIB_REV_COUNT;
+}
+
+// One revolution from an index edge: fast up to just before the expected
+// edge, slow through a window around it. Returns the steps, 0 if not found.
+static int check_one_rev(Stepper *ptr, int expected) {
+    bool stopped;
+    int fast = expected - CALIB_CHECK_WINDOW;
+    if (fast < MIN_STEPS_VALID) {
+        return 0;
+    }
+    int steps = move(ptr, +1, fast, MOTION_RAMP | travel_mode, NULL);
+    steps += move(ptr, +1, 2 * CALIB_CHECK_WINDOW, MOTION_STOP_INDEX, &stopped);
+    return stopped ? steps : 0;
+}
+
+void stepper_calibrate(Stepper *ptr,Dispenser*dis) {
+    printf("Calibrating...\n");
+
+    ptr->calibrated    = false;
+    set_steps_per_rev(ptr, 0);
+    ptr->index_hit     = false;
+    save_sm_state(dis);
+    state_flush();    // "not calibrated" must be stored before the wheel moves
+
+    // 1) Find the index edge (sync point)
+    if (!seek_index(ptr)) {
+        motor_off(ptr);
+        return;
+    }
+
+    // 2) Trust the stored steps_per_rev if one revolution agrees with it
+    config_record_t cfg;
+    int steps_per_rev = 0;
+    if (load_config(&cfg) == 0 && cfg.steps_per_rev > 0) {
+        int measured = check_one_rev(ptr, cfg.steps_per_rev);
+        int diff = measured - cfg.steps_per_rev;
+        printf("Check rev: %d steps (stored %ld)\n", measured, (long)cfg.steps_per_rev);
+        if (measured > 0 && diff <= CALIB_TOLERANCE && diff >= -CALIB_TOLERANCE) {
+            steps_per_rev = cfg.steps_per_rev;
+        } else if (measured == 0 && !seek_index(ptr)) {
             motor_off(ptr);
             return;
         }
+    }
 
-        if (ptr->index_hit) {
-            ptr->index_hit = false;
-
-            if (steps_since_index >= MIN_STEPS_VALID) {
-                rev_done++;
-                total_steps += steps_since_index;
-                printf("Rev %d: %d steps\n", rev_done, steps_since_index);
-                steps_since_index = 0;
-            } else {
-                // Too short; treat as noise/bounce
-                steps_since_index = 0;
-            }
+    // 3) Otherwise measure several full revolutions (index→index) and store the result
+    if (steps_per_rev == 0) {
+        steps_per_rev = measure_steps_per_rev(ptr);
+        if (steps_per_rev == 0) {
+            motor_off(ptr);
+            return;
+        }
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.steps_per_rev = steps_per_rev;
+        if (save_config(&cfg) != 0) {
+            printf("[Stepper] steps_per_rev not stored\n");
         }
     }
 
-    ptr->steps_per_rev = total_steps / CALIB_REV_COUNT;
+    set_steps_per_rev(ptr, steps_per_rev);
     ptr->calibrated    = true;
+    ptr->position      = 0;     // every path above ends on the index edge
+    ptr->target        = 0;
     motor_off(ptr);
 
     printf("Calibration OK. steps_per_rev = %d\n", ptr->steps_per_rev);
@@ -149,25 +266,61 @@ void stepper_calibrate(Stepper *ptr,Dispenser*dis) {
 // Move forward exactly one pill slot (CW).
 //save the motion flag to eeprom ,when slot begin and end 
 // so that a power-loss in the middle can be detected & recovered.
-
-void stepper_step_one_slot(Stepper *ptr, Dispenser *dis)
+// The move runs from the timer IRQ; poll stepper_busy() and then call
+// stepper_finish_slot(), or use stepper_step_one_slot() to block.
+bool stepper_start_one_slot(Stepper *ptr, Dispenser *dis)
 {
     if (!ptr->calibrated) {
         printf("[Stepper] Not calibrated.\n");
-        return;
+        return false;
     }
 
-    uint16_t STEPS_PER_SLOT = HALF_STEPS;
+    if (!ensure_steps_per_rev(ptr)) {
+        printf("[Stepper] steps_per_rev unknown.\n");
+        return false;
+    }
+    // Next boundary from the measured revolution, not a fixed HALF_STEPS
+    ptr->target = stepper_slot_position(ptr, current_slot(ptr) + 1);
+    uint16_t STEPS_PER_SLOT = (uint16_t)wrap_position(ptr, ptr->target - ptr->position);
     ptr->in_motion = true;
     save_sm_state(dis);
+    state_flush();    // in_motion must be stored before the wheel moves
 
     printf("[Stepper] step_one_slot: target_steps=%u\n", STEPS_PER_SLOT);
     stepper_lock_phase(ptr);
 
-    uint16_t after_recovery=STEPS_PER_SLOT;
-    while (after_recovery--) {
-        step(ptr,+1);
+    if (start_checkpointed(ptr, +1, STEPS_PER_SLOT, MOTION_RAMP | MOTION_TRACK_INDEX) != 0) {
+        ptr->in_motion = false;
+        motor_off(ptr);
+        save_sm_state(dis);
+        return false;
+    }
+    return true;
+}
+
+bool stepper_busy(Stepper *ptr) {
+    (void)ptr;
+    return motion_busy();
+}
+
+// Persist the position at the checkpoints of the move and wait until that
+// record is on the chip, so after a power loss the wheel is at most
+// POS_CHECKPOINT_STEPS + POS_FLUSH_SLACK_STEPS past the stored position
+// (and not past the target)
+void stepper_poll(Stepper *ptr, Dispenser *dis) {
+    (void)ptr;
+    if (motion_busy() && motion_steps_done() >= next_checkpoint) {
+        next_checkpoint += POS_CHECKPOINT_STEPS;
+        state_checkpoint(dis);
+        if (state_wait() != 0) {
+            printf("[Stepper] position checkpoint lost\n");
+        }
     }
+}
+
+void stepper_finish_slot(Stepper *ptr, Dispenser *dis)
+{
+    motion_wait(NULL);
 
     // Finished one full slot: we are exactly at the new slot boundary
     // ptr->current_steps_slot = 0;
@@ -180,6 +333,13 @@ void stepper_step_one_slot(Stepper *ptr, Dispenser *dis)
     printf("[Stepper] Motor stopped, waiting for pill detection check\n");
 }
 
+void stepper_step_one_slot(Stepper *ptr, Dispenser *dis)
+{
+    if (stepper_start_one_slot(ptr, dis)) {
+        stepper_finish_slot(ptr, dis);
+    }
+}
+
 // Apply fixed offset from index gap to pill-slot 0
 void stepper_apply_slot_offset(Stepper *ptr) {
     int steps = ptr->slot_offset_steps;
@@ -193,13 +353,153 @@ void stepper_apply_slot_offset(Stepper *ptr) {
 
     //printf("Apply slot offset: %d half-steps (%s)\n", steps, dir > 0 ? "CW" : "CCW");
 
-    while (steps-- > 0) {
-        step(ptr, dir);
+    move(ptr, dir, steps, MOTION_RAMP, NULL);
+    motor_off(ptr);
+}
+// Signed shortest distance from -> to on the wheel, positive = CW
+static int shortest_path(Stepper *ptr, int from, int to) {
+    int d = wrap_position(ptr, to - from);
+    return d > ptr->steps_per_rev / 2 ? d - ptr->steps_per_rev : d;
+}
+
+// Ramped move to goal. If the way is CW across the index edge (position 0),
+// stop there first: the edge verifies and corrects the estimated position.
+// Returns 1 = edge seen (*error = how far off the position was),
+// 0 = path does not cross the edge, -1 = edge expected but not seen.
+static int move_verified(Stepper *ptr, Dispenser *dis, int goal, int *error) {
+    int result = 0;
+    int steps  = shortest_path(ptr, ptr->position, goal);
+    if (steps > 0 && ptr->position + steps >= ptr->steps_per_rev) {
+        bool stopped = false;
+        int to_edge = ptr->steps_per_rev - ptr->position;
+        if (to_edge > CALIB_CHECK_WINDOW) {
+            move(ptr, +1, to_edge - CALIB_CHECK_WINDOW, MOTION_RAMP | travel_mode, NULL);
+        }
+        move(ptr, +1, 2 * CALIB_CHECK_WINDOW, MOTION_STOP_INDEX, &stopped);
+        if (stopped) {
+            int err = shortest_path(ptr, 0, ptr->position);
+            printf("[Stepper] index verified, position error %d\n", err);
+            if (error) *error = err;
+            ptr->position = 0;
+            state_checkpoint(dis);
+            result = 1;
+        } else {
+            result = -1;
+        }
+        steps = shortest_path(ptr, ptr->position, goal);
+    }
+    if (steps != 0 &&
+        start_checkpointed(ptr, steps > 0 ? +1 : -1, steps > 0 ? steps : -steps,
+                           MOTION_RAMP | MOTION_TRACK_INDEX | travel_mode) == 0) {
+        while (motion_busy()) {
+            stepper_poll(ptr, dis);   // a second power loss must find a fresh position
+        }
+    }
+    return result;
+}
+
+absolute_time_t stepper_arrival_time(Stepper *ptr) {
+    (void)ptr;
+    return motion_last_step_time();
+}
+
+motion_slip_t stepper_take_slip(Stepper *ptr, int32_t *error) {
+    (void)ptr;
+    return motion_take_slip(error);
+}
+
+// Position lost mid-cycle: find the index again and go to the given slot
+// boundary, instead of writing off the rest of the cycle
+bool stepper_resync(Stepper *ptr, Dispenser *dis, int slot) {
+    if (!ensure_steps_per_rev(ptr)) {
+        return false;
+    }
+    int goal = stepper_slot_position(ptr, slot);
+    ptr->in_motion = true;
+    ptr->target    = goal;
+    save_sm_state(dis);
+    state_flush();
+
+    bool ok = seek_index(ptr);
+    if (ok) {
+        ptr->position = 0;
+        move_verified(ptr, dis, goal, NULL);
     }
     motor_off(ptr);
+    ptr->in_motion = false;
+    save_sm_state(dis);
+    printf("[Stepper] resync to slot %d %s\n", slot, ok ? "done" : "failed");
+    return ok;
 }
-// Power-loss recovery: re-align to the mechanical reference using the optical index,
-// then apply the fixed slot offset so that we end up at a true slot boundary.
+
+// New cycle on a calibrated wheel: go forward to slot 0, which passes the
+// index edge. Only if the edge is where it should be is calibration kept.
+bool stepper_rehome(Stepper *ptr, Dispenser *dis) {
+    if (!ptr->calibrated || !ensure_steps_per_rev(ptr)) {
+        return false;
+    }
+    int goal = stepper_slot_position(ptr, 0);
+    if (wrap_position(ptr, goal - ptr->position) < ptr->steps_per_rev - ptr->position) {
+        return false;   // not behind the edge, e.g. never left slot 0
+    }
+    ptr->in_motion = true;
+    ptr->target    = goal;
+    save_sm_state(dis);
+    state_flush();
+
+    stepper_lock_phase(ptr);
+    int error = 0;
+    int r = move_verified(ptr, dis, goal, &error);
+    motor_off(ptr);
+
+    ptr->in_motion = false;
+    save_sm_state(dis);
+    if (r != 1 || error > CALIB_TOLERANCE || error < -CALIB_TOLERANCE) {
+        printf("[Stepper] re-home failed (%d, error %d)\n", r, error);
+        return false;
+    }
+    printf("[Stepper] re-homed to slot 0\n");
+    return true;
+}
+
+// Find the index edge after a power loss. The wheel stopped somewhere in
+// the `span` half-steps from the stored position towards the target of the
+// interrupted move; run fast to just before the nearest place the edge can
+// be, then slowly through the rest of the span. Falls back to a full seek
+// when the span holds the edge itself or the edge is not where it should
+// be. Ends with position 0 on the edge, false if it was never found.
+static bool recovery_find_index(Stepper *ptr, int span) {
+    int len   = span < 0 ? -span : span;
+    int front = wrap_position(ptr, span > 0 ? ptr->position + span : ptr->position);
+    int from  = wrap_position(ptr, front - len);   // CCW end of the span
+    bool stopped = false;
+
+    if (gpio_get(ptr->sensor_pin) != 0 && front != 0 && from + len < ptr->steps_per_rev) {
+        int to_edge = ptr->steps_per_rev - front;    // the least it can be
+        int fast    = to_edge - POS_RECOVERY_MARGIN;
+        if (fast > 0) {
+            move(ptr, +1, fast, MOTION_RAMP | travel_mode, NULL);
+        } else {
+            fast = 0;
+        }
+        move(ptr, +1, to_edge - fast + len + POS_RECOVERY_MARGIN, MOTION_STOP_INDEX, &stopped);
+    }
+    if (!stopped) {
+        printf("[Stepper] index not in the recovery window, seeking it\n");
+        if (!seek_index(ptr)) {
+            return false;
+        }
+    }
+    ptr->position = 0;
+    return true;
+}
+
+// Power-loss recovery: the wheel stopped somewhere between the last saved
+// position and the target of the interrupted move. The stored position
+// alone leaves up to POS_CHECKPOINT_STEPS + POS_FLUSH_SLACK_STEPS of error,
+// and the slot moves that follow never cross the edge to correct it, so
+// the index is found first. From there, the shortest move to the boundary
+// of the last completed slot; at most about a revolution in all.
 
 void stepper_recovery(Stepper *ptr, Dispenser *dis)
 {
@@ -215,65 +515,46 @@ void stepper_recovery(Stepper *ptr, Dispenser *dis)
         return;
     }
 
+    if (!ensure_steps_per_rev(ptr)) {
+        printf("[Stepper] steps_per_rev unknown - recalibration needed.\n");
+        ptr->calibrated = false;
+        save_sm_state(dis);
+        return;
+    }
+
     printf("[Stepper] RECOVERY START\n");
-    //printf("[Stepper] Completed slots: %u\n", dis->slot_done);
-    //printf("[Stepper] Current phase_index: %u\n", ptr->step_index);
 
     // Lock phase to prevent jitter
     stepper_lock_phase(ptr);
 
-    // STEP 1: Find optical index (reference point)
-    // Rotate CCW until we detect the index edge
-    int start_state = gpio_get(ptr->sensor_pin);
-    int guard = 0;
-    bool found_edge = false;
-
-    //printf("[Stepper] Searching for index edge (CCW)...\n");
-    while (!found_edge && guard < MAX_STEPS_GUARD) {
-        step(ptr, -1);  // CCW
-        guard++;
-
-        int now = gpio_get(ptr->sensor_pin);
-        if (now != start_state) {
-            found_edge = true;
-        }
+    // STEP 1: Find the index, within the span the wheel can have stopped in
+    int span = shortest_path(ptr, ptr->position, ptr->target);
+    int lost = POS_CHECKPOINT_STEPS + POS_FLUSH_SLACK_STEPS;
+    if (span > lost) {
+        span = lost;
+    } else if (span < -lost) {
+        span = -lost;
     }
-
-    if (!found_edge) {
-        printf("[Stepper] ERROR: Cannot find index edge!\n");
+    if (!recovery_find_index(ptr, span)) {
+        printf("[Stepper] RECOVERY FAILED - recalibration needed\n");
+        ptr->calibrated = false;
+        ptr->in_motion  = false;
         motor_off(ptr);
+        save_sm_state(dis);
         return;
     }
 
-    //printf("[Stepper] Index found after %d steps CCW\n", guard);
+    // STEP 2: Shortest move to the end of the last COMPLETED slot
+    int goal = stepper_slot_position(ptr, dis->slot_done);
+    ptr->target = goal;
+    state_checkpoint(dis);
 
-    // STEP 2: Apply slot offset to align to slot 0 center
-    if (ptr->slot_offset_steps > 0) {
-        //printf("[Stepper] Applying offset %d steps CCW to slot 0\n", ptr->slot_offset_steps);
-        for (int s = 0; s < ptr->slot_offset_steps; s++) {
-            step(ptr, -1);  // CCW
-        }
-    }
-
-    // STEP 3: Move CW to end of last COMPLETED slot
-    // slot_done = number of completed slots (0-based indexing)
-    // We want to be at the END of slot_done, ready to start slot (slot_done + 1)
-
-    if (dis->slot_done > 0) {
-        uint32_t steps_to_run = (uint32_t)dis->slot_done * HALF_STEPS;
+    printf("[Stepper] at the index -> %d (%d steps)\n", goal, shortest_path(ptr, 0, goal));
+    move_verified(ptr, dis, goal, NULL);
 
-        //printf("[Stepper] Moving CW %lu steps to end of slot %u\n", (unsigned long)steps_to_run, dis->slot_done);
-
-        while (steps_to_run--) {
-            step(ptr, +1);  // CW
-        }
-
-        printf("[Stepper] Now at end of slot %u\n", dis->slot_done);
-    } else {
-        printf("[Stepper] At slot 0 (no slots completed yet)\n");
-    }
+    printf("[Stepper] Now at end of slot %u\n", dis->slot_done);
 
-    // STEP 4: Clear in_motion flag
+    // STEP 3: Clear in_motion flag
     ptr->in_motion = false;
     motor_off(ptr);
 
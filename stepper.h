@@ -2,6 +2,26 @@
 #ifndef BLINK_STEPPER_H
 #define BLINK_STEPPER_H
 #include"board_config.h"
+#include "stepper_motion.h"
+#include "eeprom_bus.h"
+
+// Position checkpoints during a move: a slot move saves once, at its
+// midpoint, longer moves every POS_CHECKPOINT_STEPS. Each one waits for its
+// own state record only, while the wheel keeps turning. In the worst case
+// that record queues behind the page in flight and a full write queue, so
+// the slack is that many page writes at the fastest (full-step) cruise.
+#define POS_CHECKPOINT_STEPS  (HALF_STEPS / 2)
+#define POS_FLUSH_PAGES       (1 + EEPROM_WRITE_QUEUE_LEN + 1)
+#define POS_FLUSH_SLACK_STEPS (POS_FLUSH_PAGES * EEPROM_PAGE_WRITE_MAX_US / (MOTION_FULL_MIN_PERIOD_US / 2))
+
+// After a power loss the wheel is up to POS_CHECKPOINT_STEPS +
+// POS_FLUSH_SLACK_STEPS past the stored position. Recovery crosses the
+// index edge slowly over that whole span plus a margin each side, and sets
+// the position at the edge before it goes anywhere.
+#define POS_RECOVERY_MARGIN   MOTION_INDEX_WINDOW
+#define POS_RECOVERY_WINDOW   (POS_CHECKPOINT_STEPS + POS_FLUSH_SLACK_STEPS + 2 * POS_RECOVERY_MARGIN)
+_Static_assert(POS_RECOVERY_WINDOW < HALF_STEPS * WHEEL_SLOTS / 2,
+               "recovery window must hold at most one index edge, well inside a revolution");
 
 void stepper_init(Stepper *ptr);
 
@@ -9,7 +29,35 @@ void stepper_calibrate(Stepper *ptr,Dispenser *dis);
 
 void stepper_step_one_slot(Stepper *ptr,Dispenser *dis);
 
+// Non-blocking slot move: start, poll stepper_busy(), then finish
+bool stepper_start_one_slot(Stepper *ptr,Dispenser *dis);
+
+bool stepper_busy(Stepper *ptr);
+
+// Call while stepper_busy(): checkpoints the wheel position for recovery
+void stepper_poll(Stepper *ptr,Dispenser *dis);
+
+void stepper_finish_slot(Stepper *ptr,Dispenser *dis);
+
 void stepper_apply_slot_offset(Stepper *ptr);
 
 void stepper_recovery(Stepper *ptr,Dispenser *dis);
+
+// Position of wheel slot boundary k, spread evenly over steps_per_rev
+int stepper_slot_position(Stepper *ptr, int slot);
+
+// Back to slot 0 past the index edge; false if a full calibration is needed
+bool stepper_rehome(Stepper *ptr,Dispenser *dis);
+
+// MOTION_MODE_FULL (default), MOTION_MODE_WAVE or 0 = half-step for long travel
+void stepper_set_travel_mode(uint32_t mode);
+
+// When the last move reached its target (last step), for the pill window
+absolute_time_t stepper_arrival_time(Stepper *ptr);
+
+// Index check result of the moves since the last call, see motion_take_slip()
+motion_slip_t stepper_take_slip(Stepper *ptr, int32_t *error);
+
+// Re-find the index and go to slot boundary `slot` after the position was lost
+bool stepper_resync(Stepper *ptr,Dispenser *dis,int slot);
 #endif //BLINK_STEPPER_H
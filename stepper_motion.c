@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "stepper_motion.h"
+#include "coil_pwm.h"
+
+typedef struct {
+    Stepper *motor;
+
+    volatile bool busy;
+    volatile uint64_t last_step_us;  // time of the last coil change
+    volatile bool stopped;           // ended by a stop condition
+    volatile int32_t remaining;
+    volatile int32_t done;           // half-steps, whatever the drive mode
+    int dir;
+    uint32_t flags;
+    bool start_level;                // sensor level when the move started
+    alarm_id_t alarm;
+
+    // index tracking
+    bool expect_index;               // position wrapped to 0, edge due within the window
+    int32_t wrap_done;               // step count at the wrap
+    int32_t last_pass_done;          // step count of the last matched edge (bounce guard)
+    volatile motion_slip_t slip;
+    volatile int32_t slip_error;
+    motion_index_stats_t stats;
+
+    motion_done_cb cb;
+    void *ctx;
+} motion_t;
+
+static motion_t motion;
+
+// Half-step period after n half-steps of constant acceleration, down to the
+// full-step cruise speed. Every drive mode ramps along it by distance, so
+// the wheel speeds up the same way whatever the step size.
+#define RAMP_FLOOR_US (MOTION_FULL_MIN_PERIOD_US / 2)
+_Static_assert(MOTION_FULL_ACCEL % MOTION_ACCEL == 0, "full-step ramp indexes the table in whole steps");
+
+static uint16_t ramp_table[MOTION_RAMP_MAX];
+static int ramp_len;
+
+static void build_ramp(void) {
+    const float v0 = 1e6f / MOTION_STEP_PERIOD_US;
+    ramp_len = 0;
+    while (ramp_len < MOTION_RAMP_MAX) {
+        float v = sqrtf(v0 * v0 + 2.0f * MOTION_ACCEL * ramp_len);
+        uint32_t period = (uint32_t)(1e6f / v);
+        if (period <= RAMP_FLOOR_US) {
+            ramp_table[ramp_len++] = RAMP_FLOOR_US;
+            break;
+        }
+        ramp_table[ramp_len++] = (uint16_t)period;
+    }
+}
+
+static uint32_t cruise_period(int stride) {
+    return stride == 2 ? MOTION_FULL_MIN_PERIOD_US / 2 : MOTION_MIN_PERIOD_US;
+}
+
+// Half-step period at `dist` half-steps from the nearer end of a ramped
+// move, capped at the cruise speed of the step size. v^2 grows with
+// accel * dist, so a steeper ramp just walks the table faster.
+static uint32_t ramp_period(int32_t dist, int stride) {
+    if (motion.flags & MOTION_MODE_FULL) {
+        dist = dist * (MOTION_FULL_ACCEL / MOTION_ACCEL);
+    }
+    uint32_t period = ramp_table[dist < ramp_len ? dist : ramp_len - 1];
+    return period > cruise_period(stride) ? period : cruise_period(stride);
+}
+
+
+static bool stop_condition(Stepper *ptr) {
+    if ((motion.flags & MOTION_STOP_INDEX) && ptr->index_hit) {
+        ptr->index_hit = false;
+        return true;
+    }
+    if ((motion.flags & MOTION_STOP_SENSOR) && gpio_get(ptr->sensor_pin) != motion.start_level) {
+        return true;
+    }
+    return false;
+}
+
+static void report_slip(motion_slip_t slip, int32_t error) {
+    motion.stats.slips++;
+    if (slip > motion.slip) {   // keep the first error of the worst kind
+        motion.slip       = slip;
+        motion.slip_error = error;
+    }
+}
+
+// Edge seen or overdue on a tracked CW move. The edge is position 0, so the
+// counted position there is the error; the move is stretched or shortened
+// by it so it still ends on its target.
+static void track_index(Stepper *ptr) {
+    if (ptr->index_hit) {
+        ptr->index_hit = false;
+        if (motion.dir < 0 || motion.done - motion.last_pass_done < MOTION_INDEX_WINDOW) {
+            return;   // CCW edge is the far side of the gap, or bounce of the last one
+        }
+        int32_t err = ptr->position;
+        if (err > ptr->steps_per_rev / 2) {
+            err -= ptr->steps_per_rev;
+        }
+        motion.expect_index   = false;
+        motion.last_pass_done = motion.done;
+        motion.stats.last_error = err;
+        if (err > MOTION_INDEX_WINDOW || err < -MOTION_INDEX_WINDOW) {
+            report_slip(MOTION_SLIP_LOST, err);   // far off: noise or a big slip, don't trust either
+            return;
+        }
+        motion.stats.passes++;
+        if (err != 0) {
+            motion.stats.corrected++;
+            ptr->position = 0;
+            motion.remaining += err;
+            if (motion.remaining < 0) motion.remaining = 0;
+        }
+        if (err > MOTION_DRIFT_MAX || err < -MOTION_DRIFT_MAX) {
+            report_slip(MOTION_SLIP_CORRECTED, err);
+        }
+    } else if (motion.expect_index && motion.done - motion.wrap_done > MOTION_INDEX_WINDOW) {
+        motion.expect_index = false;
+        report_slip(MOTION_SLIP_LOST, 0);         // stalled, or slipped past the edge unseen
+    }
+}
+
+static void finish(bool stopped) {
+    coil_set_phase(COIL_HOLD, motion.motor->step_index);   // standing still: hold current
+    motion.alarm   = 0;
+    motion.stopped = stopped;
+    motion.busy    = false;
+    if (motion.cb) {
+        motion.cb(motion.motor, motion.done, stopped, motion.ctx);
+    }
+}
+
+// One tick per step period. Conditions are checked before stepping, so like
+// the old step()+sleep loop the last step still gets a full period to settle.
+static int64_t motion_alarm(alarm_id_t id, void *user_data) {
+    (void)id;
+    (void)user_data;
+    Stepper *ptr = motion.motor;
+
+    if (!motion.busy) {
+        motion.alarm = 0;
+        return 0;
+    }
+    if (stop_condition(ptr)) {
+        finish(true);
+        return 0;
+    }
+    if ((motion.flags & MOTION_TRACK_INDEX) && ptr->steps_per_rev > 0) {
+        track_index(ptr);
+    }
+    if (motion.remaining <= 0) {
+        finish(false);
+        return 0;
+    }
+    // Full/wave modes take whole steps on the odd/even entries of the
+    // half-step table. A phase off that sequence first takes one half-step,
+    // and the last MOTION_FINE_STEPS are half-steps for the final approach.
+    int stride = 1;
+    uint32_t mode = motion.flags & (MOTION_MODE_FULL | MOTION_MODE_WAVE);
+    if (mode && motion.remaining > MOTION_FINE_STEPS) {
+        bool odd = (ptr->step_index & 1) != 0;
+        if (odd == (mode == MOTION_MODE_FULL)) {
+            stride = 2;
+        }
+    }
+    bool accelerating = (motion.flags & MOTION_RAMP) && motion.done < motion.remaining &&
+                        ramp_period(motion.done, stride) > cruise_period(stride);
+
+    // Full boost to break away and while accelerating, run current otherwise
+    coil_level_t level = (motion.done < MOTION_BOOST_STEPS || accelerating) ? COIL_BOOST : COIL_RUN;
+
+    ptr->step_index = (ptr->step_index + motion.dir * stride + 8) % 8;
+    coil_set_phase(level, ptr->step_index);
+    motion.last_step_us = time_us_64();
+
+    int pos = ptr->position + motion.dir * stride;
+    if (ptr->steps_per_rev > 0) {
+        if (pos < 0) {
+            pos += ptr->steps_per_rev;
+        } else if (pos >= ptr->steps_per_rev) {
+            pos -= ptr->steps_per_rev;
+            if (motion.done - motion.last_pass_done >= MOTION_INDEX_WINDOW) {
+                motion.expect_index = true;   // unless the edge already came early
+                motion.wrap_done    = motion.done;
+            }
+        }
+    }
+    ptr->position = pos;
+    motion.remaining -= stride;
+    motion.done      += stride;
+
+    uint32_t period = MOTION_STEP_PERIOD_US;
+    if (motion.flags & MOTION_RAMP) {
+        // Distance to the nearer end of the move picks the speed, so the
+        // profile is symmetric and short moves become triangles
+        int32_t dist = motion.done < motion.remaining ? motion.done : motion.remaining;
+        period = ramp_period(dist, stride);
+    }
+    // an unramped full step keeps the wheel at the start speed
+    return -(int64_t)(period * stride);   // relative to the scheduled time, no drift
+}
+
+void motion_init(Stepper *ptr) {
+    motion.motor = ptr;
+    coil_init(ptr->pins);
+    motion.busy  = false;
+    motion.alarm = 0;
+    build_ramp();
+}
+
+int motion_start(Stepper *ptr, int dir, int32_t steps, uint32_t flags,
+                 motion_done_cb cb, void *ctx) {
+    if (motion.busy) {
+        return -1;
+    }
+    motion.motor       = ptr;
+    motion.dir         = dir >= 0 ? +1 : -1;
+    motion.remaining   = steps;
+    motion.done        = 0;
+    motion.flags       = flags;
+    motion.start_level = gpio_get(ptr->sensor_pin);
+    motion.stopped     = false;
+    motion.cb          = cb;
+    motion.ctx         = ctx;
+    if (flags & (MOTION_STOP_INDEX | MOTION_TRACK_INDEX)) {
+        ptr->index_hit = false;
+    }
+    motion.expect_index   = false;
+    motion.last_pass_done = -MOTION_INDEX_WINDOW;
+    motion.busy = true;
+
+    motion.alarm = add_alarm_in_us(MOTION_STEP_PERIOD_US, motion_alarm, NULL, true);
+    if (motion.alarm < 0) {
+        motion.busy = false;
+        printf("[Stepper] no alarm available\n");
+        return -1;
+    }
+    return 0;
+}
+
+bool motion_busy(void) {
+    return motion.busy;
+}
+
+int32_t motion_steps_done(void) {
+    return motion.done;
+}
+
+absolute_time_t motion_last_step_time(void) {
+    return from_us_since_boot(motion.last_step_us);
+}
+
+int32_t motion_wait(bool *stopped) {
+    while (motion.busy) {
+        tight_loop_contents();
+    }
+    if (stopped) {
+        *stopped = motion.stopped;
+    }
+    return motion.done;
+}
+
+motion_slip_t motion_take_slip(int32_t *error) {
+    motion_slip_t slip = motion.slip;
+    if (error) {
+        *error = motion.slip_error;
+    }
+    motion.slip       = MOTION_SLIP_NONE;
+    motion.slip_error = 0;
+    return slip;
+}
+
+const motion_index_stats_t *motion_index_stats(void) {
+    return &motion.stats;
+}
+
+void motion_stop(void) {
+    if (motion.busy) {
+        motion.remaining = 0;   // next tick ends the move
+    }
+}
+
+void motion_hold(Stepper *ptr) {
+    coil_set_phase(COIL_HOLD, ptr->step_index);
+}
+
+void motion_release(Stepper *ptr) {
+    (void)ptr;
+    coil_off();
+}
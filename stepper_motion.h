@@ -0,0 +1,86 @@
+#ifndef PILL_DISPENSER_STEPPER_MOTION_H
+#define PILL_DISPENSER_STEPPER_MOTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "board_config.h"
+
+#define MOTION_STEP_PERIOD_US 2000   // unramped moves and the start speed of ramps (500 half-steps/s)
+#define MOTION_MIN_PERIOD_US  1000   // cruise speed of ramped half-step moves (1000 half-steps/s)
+#define MOTION_ACCEL          4000   // half-steps/s^2 while ramping half-step and wave moves
+#define MOTION_RAMP_MAX       512    // delay table entries, one per half-step, enough for start -> full-step cruise
+#define MOTION_BOOST_STEPS    8      // first steps of every move at boost current
+
+// motion_start() flags. Stop conditions are checked before every step.
+#define MOTION_STOP_INDEX  (1u << 0)   // index_hit set by the opto fork IRQ (flag is consumed)
+#define MOTION_STOP_SENSOR (1u << 1)   // sensor level differs from the level at start
+#define MOTION_RAMP        (1u << 2)   // trapezoid profile: accelerate, cruise, decelerate to a stop
+#define MOTION_TRACK_INDEX (1u << 3)   // CW: check each index pass against position 0, correct drift
+
+// Drive mode of a move, half-step when neither is set. Steps, position and
+// step_index stay in half-step units in every mode, so modes can be mixed
+// freely between moves.
+// Full and wave steps start at the same wheel speed as half-steps and ramp
+// on to a cruise twice as fast. Two phases on carry a steeper ramp, so full
+// moves also get the slot-to-slot distance over with sooner.
+#define MOTION_MODE_FULL   (1u << 4)   // two-phase full steps: up to 2x travel speed, more torque
+#define MOTION_MODE_WAVE   (1u << 5)   // one-phase full steps: same cruise at MOTION_ACCEL, half the current
+#define MOTION_FINE_STEPS      16      // full/wave moves end with this many half-steps
+#define MOTION_FULL_MIN_PERIOD_US 1000 // cruise period of one full step (2000 half-steps/s)
+#define MOTION_FULL_ACCEL     (2 * MOTION_ACCEL)   // ramp of MOTION_MODE_FULL moves
+
+#define MOTION_DRIFT_MAX    4    // index errors up to this are corrected silently
+#define MOTION_INDEX_WINDOW 32   // further off than this, or no edge at all: position lost
+
+typedef enum {
+    MOTION_SLIP_NONE,
+    MOTION_SLIP_CORRECTED,       // edge off by more than MOTION_DRIFT_MAX, position corrected
+    MOTION_SLIP_LOST             // edge missing or far off, position unknown
+} motion_slip_t;
+
+typedef struct {
+    uint32_t passes;             // index edges matched to position 0
+    uint32_t corrected;          // passes with a non-zero error
+    uint32_t slips;              // errors beyond MOTION_DRIFT_MAX, missed or unexpected edges
+    int32_t  last_error;         // counted position at the edge, >0 = wheel behind the count
+} motion_index_stats_t;
+
+// Called from the timer IRQ once a move ends; may start the next move
+typedef void (*motion_done_cb)(Stepper *ptr, int32_t steps, bool stopped, void *ctx);
+
+// Hardware-timed motion: a repeating alarm advances the coil phase through
+// the PWM coil driver (coil_pwm.h): boost current to break away and while
+// accelerating, run current at cruise, hold current once stopped.
+void motion_init(Stepper *ptr);
+
+// Start an asynchronous move of up to `steps` half-steps, dir = +1 CW / -1 CCW.
+// Ramped moves should be of known length: a stop condition ends them at speed.
+// Returns -1 if a move is already running.
+int motion_start(Stepper *ptr, int dir, int32_t steps, uint32_t flags,
+                 motion_done_cb cb, void *ctx);
+
+bool motion_busy(void);
+
+// Steps taken so far by the current (or last) move
+int32_t motion_steps_done(void);
+
+// When the last step was taken, i.e. when the wheel arrived
+absolute_time_t motion_last_step_time(void);
+
+// Block until the current move ends. Returns the steps taken,
+// *stopped tells whether a stop condition ended it (may be NULL).
+int32_t motion_wait(bool *stopped);
+
+// Abort the current move after the step in progress
+void motion_stop(void);
+
+// Worst index result since the last call, *error = its step error (may be NULL)
+motion_slip_t motion_take_slip(int32_t *error);
+
+const motion_index_stats_t *motion_index_stats(void);
+
+// Energise the coils for the current step_index at hold current / switch them all off
+void motion_hold(Stepper *ptr);
+void motion_release(Stepper *ptr);
+
+#endif //PILL_DISPENSER_STEPPER_MOTION_H
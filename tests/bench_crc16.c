@@ -0,0 +1,63 @@
+// Host micro-benchmark of the CPU CRC backends. The bitwise loop is the
+// reference the log was written with, so the table must match it for every
+// length before its speed means anything. The DMA sniffer only exists on the
+// target, where crc16_init() checks it against the bitwise loop at boot.
+#include <stdio.h>
+#include <time.h>
+#include "sim.h"
+#include "crc16.h"
+
+static uint8_t buf[1024];
+
+static uint16_t crc_with(crc16_backend_t backend, const uint8_t *data, size_t len) {
+    crc16_init(backend);
+    return crc16(data, len);
+}
+
+static double host_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, crc16_backend_t backend, size_t len) {
+    const size_t total = 64u * 1024 * 1024;
+    size_t rounds = total / len;
+    uint16_t crc = 0;
+    crc16_init(backend);
+    double start = host_seconds();
+    for (size_t i = 0; i < rounds; i++) {
+        buf[0] = (uint8_t)crc;               // chain the calls so none can be hoisted
+        crc = crc16(buf, len);
+    }
+    double s = host_seconds() - start;
+    printf("%-8s %4u B: %7.1f MB/s (crc 0x%04x)\n", name, (unsigned)len,
+           (double)len * rounds / (s > 0 ? s : 1e-9) / 1e6, crc);
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)(i * 37 + 11);
+    }
+
+    // CRC-16/CCITT-FALSE check value
+    const uint8_t check[] = "123456789";
+    CHECK(crc_with(CRC16_BITWISE, check, 9) == 0x29B1);
+    CHECK(crc_with(CRC16_TABLE, check, 9) == 0x29B1);
+    CHECK(crc_with(CRC16_TABLE, buf, 0) == 0xFFFF);
+
+    for (size_t len = 0; len <= 300; len++) {
+        for (size_t off = 0; off < 4; off++) {
+            CHECK(crc_with(CRC16_TABLE, buf + off, len) == crc_with(CRC16_BITWISE, buf + off, len));
+        }
+    }
+
+    const size_t lens[] = {16, 64, sizeof(buf)};
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        bench("bitwise", CRC16_BITWISE, lens[i]);
+        bench("table", CRC16_TABLE, lens[i]);
+    }
+
+    printf("%s\n", sim_failures ? "FAILED" : "OK");
+    return sim_failures ? 1 : 0;
+}
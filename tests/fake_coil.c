@@ -0,0 +1,37 @@
+#include "fake_coil.h"
+#include "sim.h"
+
+fake_coil_event_t fake_coil_log[FAKE_COIL_LOG];
+int fake_coil_events;
+
+static void record(int phase, coil_level_t level) {
+    if (fake_coil_events < FAKE_COIL_LOG) {
+        fake_coil_event_t *e = &fake_coil_log[fake_coil_events];
+        e->t_us  = sim_now();
+        e->phase = phase;
+        e->level = level;
+    }
+    fake_coil_events++;
+}
+
+void fake_coil_clear(void) {
+    fake_coil_events = 0;
+}
+
+void coil_init(const uint pins[4]) {
+    (void)pins;
+    fake_coil_clear();
+}
+
+void coil_set_phase(coil_level_t level, int phase) {
+    record(phase, level);
+}
+
+void coil_off(void) {
+    record(-1, COIL_HOLD);
+}
+
+void coil_set_duty(coil_level_t level, uint8_t percent) {
+    (void)level;
+    (void)percent;
+}
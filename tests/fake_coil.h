@@ -0,0 +1,20 @@
+#ifndef PILL_TEST_FAKE_COIL_H
+#define PILL_TEST_FAKE_COIL_H
+
+#include "coil_pwm.h"
+
+// coil_pwm.h stand-in that records every phase change with its time
+#define FAKE_COIL_LOG 4096
+
+typedef struct {
+    uint64_t t_us;
+    int phase;              // -1 = coil_off()
+    coil_level_t level;
+} fake_coil_event_t;
+
+extern fake_coil_event_t fake_coil_log[FAKE_COIL_LOG];
+extern int fake_coil_events;
+
+void fake_coil_clear(void);
+
+#endif //PILL_TEST_FAKE_COIL_H
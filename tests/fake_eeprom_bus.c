@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <string.h>
+#include "fake_eeprom_bus.h"
+#include "sim.h"
+
+uint8_t  fake_eeprom_mem[EEPROM_TOTAL_BYTES];
+uint32_t fake_eeprom_page_writes[FAKE_EEPROM_PAGES];
+
+void fake_eeprom_reset(void) {
+    memset(fake_eeprom_mem, 0xFF, sizeof(fake_eeprom_mem));
+    memset(fake_eeprom_page_writes, 0, sizeof(fake_eeprom_page_writes));
+}
+
+void eeprom_bus_init(void) {
+}
+
+static uint32_t issued;
+
+int eeprom_bus_write_page(uint16_t addr, const uint8_t *data, size_t len, uint32_t *ticket) {
+    CHECK(len > 0 && addr % EEPROM_PAGE_SIZE + len <= EEPROM_PAGE_SIZE);
+    if ((uint32_t)addr + len > EEPROM_TOTAL_BYTES) {
+        return -1;
+    }
+    memcpy(&fake_eeprom_mem[addr], data, len);
+    fake_eeprom_page_writes[addr / EEPROM_PAGE_SIZE]++;
+    if (ticket) {
+        *ticket = issued;
+    }
+    issued++;
+    return 0;
+}
+
+int eeprom_bus_read(uint16_t addr, uint8_t *data, size_t len) {
+    if ((uint32_t)addr + len > EEPROM_TOTAL_BYTES) {
+        return -1;
+    }
+    memcpy(data, &fake_eeprom_mem[addr], len);
+    return 0;
+}
+
+bool eeprom_bus_busy(void) {
+    return false;
+}
+
+int eeprom_bus_wait(void) {
+    return 0;
+}
+
+int eeprom_bus_wait_ticket(uint32_t ticket) {
+    (void)ticket;
+    return 0;
+}
+
+int eeprom_bus_drain(void) {
+    return 0;
+}
+
+uint32_t eeprom_bus_failures(void) {
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef PILL_TEST_FAKE_EEPROM_BUS_H
+#define PILL_TEST_FAKE_EEPROM_BUS_H
+
+#include "eeprom_bus.h"
+#include "eeprom_layout.h"
+
+#define FAKE_EEPROM_PAGES (EEPROM_TOTAL_BYTES / EEPROM_PAGE_SIZE)
+
+// eeprom_bus.h on a RAM array: writes complete at once, only the write
+// cycles each page goes through are counted
+extern uint8_t  fake_eeprom_mem[EEPROM_TOTAL_BYTES];
+extern uint32_t fake_eeprom_page_writes[FAKE_EEPROM_PAGES];
+
+void fake_eeprom_reset(void);
+
+#endif //PILL_TEST_FAKE_EEPROM_BUS_H
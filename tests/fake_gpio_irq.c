@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include "fake_gpio_irq.h"
+#include "hardware/gpio.h"
+
+static struct {
+    gpio_irq_handler_t handler;
+    void *ctx;
+} pins[NUM_BANK0_GPIOS];
+
+static gpio_irq_stats_t stats[NUM_BANK0_GPIOS];
+
+void gpio_irq_register(uint gpio, gpio_irq_handler_t handler, void *ctx,
+                       const gpio_irq_filter_t *f) {
+    (void)f;
+    if (gpio < NUM_BANK0_GPIOS) {
+        pins[gpio].handler = handler;
+        pins[gpio].ctx     = ctx;
+    }
+}
+
+void fake_gpio_irq_edge(uint gpio, uint32_t events) {
+    if (gpio < NUM_BANK0_GPIOS && pins[gpio].handler) {
+        stats[gpio].accepted++;
+        pins[gpio].handler(pins[gpio].ctx, gpio, events);
+    }
+}
+
+const gpio_irq_stats_t *gpio_irq_stats(uint gpio) {
+    return &stats[gpio < NUM_BANK0_GPIOS ? gpio : 0];
+}
+
+void gpio_irq_print_stats(void) {
+}
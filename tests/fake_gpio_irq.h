@@ -0,0 +1,10 @@
+#ifndef PILL_TEST_FAKE_GPIO_IRQ_H
+#define PILL_TEST_FAKE_GPIO_IRQ_H
+
+#include "gpio_irq.h"
+
+// gpio_irq.h stand-in: registration only, no filter. The test raises an
+// accepted edge on a pin with fake_gpio_irq_edge().
+void fake_gpio_irq_edge(uint gpio, uint32_t events);
+
+#endif //PILL_TEST_FAKE_GPIO_IRQ_H
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_i2c.h"
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+#define SLOT_UNUSED 0xFFFFFFFFu
+#define MAX_WORDS   1024
+
+sim_eeprom_t sim_eeprom;
+
+static i2c_hw_t hw;
+static uint32_t slot_head;         // next slot handed out
+static uint32_t slot_tail;         // next slot to collect
+
+static uint16_t words[MAX_WORDS];  // IC_DATA_CMD words not yet on the bus
+static int n_words;
+
+static struct {
+    bool active;
+    bool addressed;                // address byte is out
+    bool nacked;                   // address NACKed, only the STOP is left
+    bool stopping;                 // the byte on the wire carries STOP
+    uint64_t start;
+    uint64_t next;                 // end of the byte on the wire
+    uint16_t words[MAX_WORDS];
+    int n;
+} xfer;
+
+static int tx_chan = -1;
+static uint32_t tx_sent;
+static int rx_chan = -1;
+static uint32_t rx_done;
+static uint16_t addr_ptr;          // chip's internal address counter
+
+uint32_t sim_i2c_slot(void) {
+    uint32_t k = slot_head++ % SIM_I2C_SLOTS;
+    hw.data_cmd_slot[k] = SLOT_UNUSED;
+    return k;
+}
+
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) {
+    (void)i2c;
+    return &hw;
+}
+
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+    (void)i2c;
+    return is_tx ? 32 : 33;
+}
+
+static void push_word(uint32_t w) {
+    if (n_words < MAX_WORDS) {
+        words[n_words++] = (uint16_t)w;
+    }
+}
+
+// Slots that were written are CPU pushes into the TX FIFO; reads and &data_cmd
+// also take a slot but leave it unused
+static void collect(void) {
+    while (slot_tail != slot_head) {
+        uint32_t v = hw.data_cmd_slot[slot_tail++ % SIM_I2C_SLOTS];
+        if (v != SLOT_UNUSED) {
+            push_word(v);
+        }
+    }
+}
+
+static bool is_data_cmd(const volatile void *p) {
+    uintptr_t a = (uintptr_t)p;
+    return a >= (uintptr_t)&hw.data_cmd_slot[0] && a < (uintptr_t)&hw.data_cmd_slot[SIM_I2C_SLOTS];
+}
+
+// The TX channel keeps the FIFO topped up as the wire drains it
+static void feed(void) {
+    if (tx_chan < 0) {
+        return;
+    }
+    sim_dma_channel_t *d = &sim_dma[tx_chan];
+    const volatile uint16_t *src = d->read_addr;
+    while (d->busy && n_words < SIM_I2C_FIFO) {
+        push_word(d->cfg.read_increment ? src[tx_sent] : src[0]);
+        if (++tx_sent == d->count) {
+            d->busy = false;
+        }
+    }
+}
+
+static void dma_started(uint ch) {
+    sim_dma_channel_t *d = &sim_dma[ch];
+    collect();   // words the CPU pushed before the transfer go first
+    if (is_data_cmd(d->write_addr)) {
+        tx_chan = (int)ch;
+        tx_sent = 0;
+        feed();
+    } else if (is_data_cmd(d->read_addr)) {
+        rx_chan = (int)ch;
+        rx_done = 0;
+    }
+}
+
+static void deliver(uint8_t byte) {
+    if (rx_chan < 0 || !sim_dma[rx_chan].busy) {
+        return;   // e.g. the byte of an ACK poll, drained by nobody
+    }
+    sim_dma_channel_t *d = &sim_dma[rx_chan];
+    ((volatile uint8_t*)d->write_addr)[rx_done++] = byte;
+    if (rx_done == d->count) {
+        d->busy = false;
+    }
+}
+
+static void raise(uint32_t stat) {
+    hw.intr_stat = stat;
+    sim_irq(I2C0_IRQ);
+    hw.intr_stat = 0;
+}
+
+// The chip NACKs its address: TX_ABRT now, the FIFO is flushed, STOP follows
+static void nack(void) {
+    sim_eeprom.nacks++;
+    hw.tx_abrt_source = 1;    // 7-bit address NACK
+    raise(I2C_IC_INTR_STAT_R_TX_ABRT_BITS);
+    collect();
+    n_words = 0;
+    xfer.nacked = true;
+    xfer.next += SIM_I2C_BYTE_US;
+}
+
+static void complete(void) {
+    xfer.active = false;
+    if (xfer.nacked) {
+        raise(I2C_IC_INTR_STAT_R_STOP_DET_BITS);
+        return;
+    }
+    int w = 0;
+    while (w < xfer.n && !(xfer.words[w] & I2C_IC_DATA_CMD_CMD_BITS)) {
+        w++;
+    }
+    if (w >= 2) {
+        addr_ptr = (uint16_t)(((xfer.words[0] & 0xFF) << 8 | (xfer.words[1] & 0xFF)) % SIM_EEPROM_SIZE);
+    }
+    int len = w - 2;
+    if (len > 0) {
+        uint16_t page = addr_ptr & ~(SIM_EEPROM_PAGE - 1);
+        if ((addr_ptr % SIM_EEPROM_PAGE) + len > SIM_EEPROM_PAGE) {
+            sim_eeprom.page_overruns++;
+        }
+        for (int i = 0; i < len; i++) {
+            sim_eeprom.mem[page | ((addr_ptr + i) % SIM_EEPROM_PAGE)] = (uint8_t)xfer.words[2 + i];
+        }
+        addr_ptr = page | ((addr_ptr + len) % SIM_EEPROM_PAGE);
+        sim_eeprom.page_writes[page / SIM_EEPROM_PAGE]++;
+        sim_eeprom.write_transactions++;
+        sim_eeprom.last_write_done_us = xfer.next + SIM_EEPROM_TWC_US;
+    }
+    for (int i = w; i < xfer.n; i++) {
+        deliver(sim_eeprom.mem[addr_ptr]);
+        addr_ptr = (addr_ptr + 1) % SIM_EEPROM_SIZE;
+    }
+    raise(I2C_IC_INTR_STAT_R_STOP_DET_BITS);
+}
+
+// One tick: a transaction starts as soon as the FIFO holds a word, the
+// address byte decides ACK or NACK, then one word goes out per byte time
+// until the word with STOP. An empty FIFO holds the bus, as the real master does.
+static void tick(void) {
+    collect();
+    feed();
+    if (!xfer.active) {
+        if (n_words > 0) {
+            xfer.active    = true;
+            xfer.addressed = false;
+            xfer.nacked    = false;
+            xfer.stopping  = false;
+            xfer.n         = 0;
+            xfer.start     = sim_now();
+            xfer.next      = xfer.start + SIM_I2C_BYTE_US;
+            sim_eeprom.transactions++;
+        }
+        return;
+    }
+    if (sim_now() < xfer.next) {
+        return;
+    }
+    if (xfer.nacked || xfer.stopping) {
+        complete();
+    } else if (!xfer.addressed) {
+        xfer.addressed = true;
+        if (sim_eeprom.dead || xfer.start < sim_eeprom.last_write_done_us) {
+            nack();
+        }
+    } else if (n_words > 0) {
+        uint16_t w = words[0];
+        memmove(words, words + 1, (size_t)(n_words - 1) * sizeof(words[0]));
+        n_words--;
+        if (xfer.n < MAX_WORDS) {
+            xfer.words[xfer.n++] = w;
+        }
+        xfer.stopping = (w & I2C_IC_DATA_CMD_STOP_BITS) != 0;
+        xfer.next = sim_now() + SIM_I2C_BYTE_US;
+    }
+}
+
+void sim_i2c_init(void) {
+    memset(&sim_eeprom, 0, sizeof(sim_eeprom));
+    memset(sim_eeprom.mem, 0xFF, sizeof(sim_eeprom.mem));
+    memset(&xfer, 0, sizeof(xfer));
+    n_words   = 0;
+    slot_tail = slot_head;
+    tx_chan   = -1;
+    rx_chan   = -1;
+    sim_dma_started = dma_started;
+    sim_set_hook(tick);
+}
@@ -0,0 +1,35 @@
+#ifndef PILL_TEST_SIM_I2C_H
+#define PILL_TEST_SIM_I2C_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SIM_EEPROM_SIZE  32768
+#define SIM_EEPROM_PAGE  64
+#define SIM_EEPROM_TWC_US 5000    // datasheet tWC max
+#define SIM_I2C_BYTE_US  90       // 9 clocks at 100 kHz
+#define SIM_I2C_FIFO     16       // IC_TX_BUFFER_DEPTH
+
+// 24LC256 on a simulated I2C0: the chip NACKs its address while a write
+// cycle runs, wraps writes inside the page like the real part, and counts
+// every page it programs. Transfers come from the eeprom_bus DMA setup and
+// data_cmd writes, paced through a 16 word TX FIFO. An address NACK raises
+// TX_ABRT after the address byte and flushes the FIFO, STOP_DET follows one
+// byte later; words pushed after that start a new transaction.
+typedef struct {
+    uint8_t  mem[SIM_EEPROM_SIZE];
+    uint32_t page_writes[SIM_EEPROM_SIZE / SIM_EEPROM_PAGE];
+    uint32_t transactions;        // every START on the bus
+    uint32_t write_transactions;
+    uint32_t page_overruns;       // writes that wrapped inside their page
+    uint32_t nacks;
+    uint64_t last_write_done_us;  // end of the last write cycle
+    bool     dead;                // NACK everything, e.g. chip unplugged
+} sim_eeprom_t;
+
+extern sim_eeprom_t sim_eeprom;
+
+// Reset the chip to erased (0xFF) and hook the model into the clock
+void sim_i2c_init(void);
+
+#endif //PILL_TEST_SIM_I2C_H
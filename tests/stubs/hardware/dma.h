@@ -0,0 +1,55 @@
+#ifndef PILL_TEST_HARDWARE_DMA_H
+#define PILL_TEST_HARDWARE_DMA_H
+
+#include "pico/types.h"
+
+#define SIM_DMA_CHANNELS 12
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC16 0x2u
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+typedef struct {
+    enum dma_channel_transfer_size size;
+    bool read_increment;
+    bool write_increment;
+    bool sniff;
+    uint dreq;
+    uint chain_to;
+} dma_channel_config;
+
+typedef struct {
+    io_rw_32 sniff_data;
+} dma_hw_t;
+
+extern dma_hw_t *const dma_hw;
+
+// Channels only record their setup; a peripheral model picks transfers up
+// through sim_dma_started and moves the data itself
+typedef struct {
+    bool claimed;
+    bool busy;
+    dma_channel_config cfg;
+    volatile void *write_addr;
+    const volatile void *read_addr;
+    uint32_t count;
+} sim_dma_channel_t;
+
+extern sim_dma_channel_t sim_dma[SIM_DMA_CHANNELS];
+extern void (*sim_dma_started)(uint channel);
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void channel_config_set_chain_to(dma_channel_config *c, uint chain_to);
+void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable);
+
+#endif //PILL_TEST_HARDWARE_DMA_H
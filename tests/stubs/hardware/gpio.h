@@ -0,0 +1,27 @@
+#ifndef PILL_TEST_HARDWARE_GPIO_H
+#define PILL_TEST_HARDWARE_GPIO_H
+
+#include "pico/types.h"
+
+#define NUM_BANK0_GPIOS 30
+#define GPIO_IN  false
+#define GPIO_OUT true
+
+enum gpio_function { GPIO_FUNC_I2C = 3, GPIO_FUNC_UART = 2 };
+
+enum gpio_irq_level {
+    GPIO_IRQ_LEVEL_LOW  = 0x1u,
+    GPIO_IRQ_LEVEL_HIGH = 0x2u,
+    GPIO_IRQ_EDGE_FALL  = 0x4u,
+    GPIO_IRQ_EDGE_RISE  = 0x8u,
+};
+
+// Input levels come from sim_gpio_set(), outputs are ignored
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_pull_up(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+
+#endif //PILL_TEST_HARDWARE_GPIO_H
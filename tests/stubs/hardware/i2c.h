@@ -0,0 +1,46 @@
+#ifndef PILL_TEST_HARDWARE_I2C_H
+#define PILL_TEST_HARDWARE_I2C_H
+
+#include "pico/types.h"
+
+typedef struct i2c_inst i2c_inst_t;
+extern i2c_inst_t sim_i2c0_inst;
+#define i2c0 (&sim_i2c0_inst)
+
+#define I2C_IC_DATA_CMD_CMD_BITS          0x00000100u
+#define I2C_IC_DATA_CMD_STOP_BITS         0x00000200u
+#define I2C_IC_INTR_STAT_R_TX_ABRT_BITS   0x00000040u
+#define I2C_IC_INTR_STAT_R_STOP_DET_BITS  0x00000200u
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS   0x00000040u
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS  0x00000200u
+#define I2C_IC_DMA_CR_RDMAE_BITS          0x00000001u
+#define I2C_IC_DMA_CR_TDMAE_BITS          0x00000002u
+
+#define SIM_I2C_SLOTS 4096
+
+typedef struct {
+    io_rw_32 data_cmd_slot[SIM_I2C_SLOTS];
+    io_rw_32 enable;
+    io_rw_32 tar;
+    io_rw_32 dma_tdlr;
+    io_rw_32 dma_rdlr;
+    io_rw_32 dma_cr;
+    io_rw_32 intr_mask;
+    io_ro_32 intr_stat;
+    io_ro_32 tx_abrt_source;
+    io_ro_32 clr_tx_abrt;
+    io_ro_32 clr_stop_det;
+    io_ro_32 clr_intr;
+    io_ro_32 rxflr;
+} i2c_hw_t;
+
+// A C store cannot be trapped, so every use of data_cmd gets a fresh slot
+// and the bus model (sim_i2c.c) collects the slots that were written, in order
+uint32_t sim_i2c_slot(void);
+#define data_cmd data_cmd_slot[sim_i2c_slot()]
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c);
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx);
+
+#endif //PILL_TEST_HARDWARE_I2C_H
@@ -0,0 +1,14 @@
+#ifndef PILL_TEST_HARDWARE_IRQ_H
+#define PILL_TEST_HARDWARE_IRQ_H
+
+#include "pico/types.h"
+
+typedef void (*irq_handler_t)(void);
+
+enum { I2C0_IRQ = 23, SIM_NUM_IRQS = 32 };
+
+// Handlers are called by the peripheral models through sim_irq()
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+#endif //PILL_TEST_HARDWARE_IRQ_H
@@ -0,0 +1,9 @@
+#ifndef PILL_TEST_HARDWARE_RTC_H
+#define PILL_TEST_HARDWARE_RTC_H
+
+#include "pico/types.h"
+
+// Wall clock derived from the simulated clock, starting 2025-12-07 00:00:00
+bool rtc_get_datetime(datetime_t *t);
+
+#endif //PILL_TEST_HARDWARE_RTC_H
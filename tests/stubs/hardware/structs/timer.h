@@ -0,0 +1,14 @@
+#ifndef PILL_TEST_HARDWARE_STRUCTS_TIMER_H
+#define PILL_TEST_HARDWARE_STRUCTS_TIMER_H
+
+#include "pico/types.h"
+
+// Raw counter of the simulated clock, kept current by sim_advance()
+typedef struct {
+    io_ro_32 timerawh;
+    io_ro_32 timerawl;
+} timer_hw_t;
+
+extern timer_hw_t *const timer_hw;
+
+#endif //PILL_TEST_HARDWARE_STRUCTS_TIMER_H
@@ -0,0 +1,9 @@
+#ifndef PILL_TEST_HARDWARE_SYNC_H
+#define PILL_TEST_HARDWARE_SYNC_H
+
+#include "pico/types.h"
+
+// Single threaded, nothing to order
+static inline void __dmb(void) {}
+
+#endif //PILL_TEST_HARDWARE_SYNC_H
@@ -0,0 +1,6 @@
+#ifndef PILL_TEST_PICO_STDIO_H
+#define PILL_TEST_PICO_STDIO_H
+
+#include <stdio.h>
+
+#endif //PILL_TEST_PICO_STDIO_H
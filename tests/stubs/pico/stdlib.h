@@ -0,0 +1,13 @@
+#ifndef PILL_TEST_PICO_STDLIB_H
+#define PILL_TEST_PICO_STDLIB_H
+
+#include "pico/types.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+#define PICO_ERROR_TIMEOUT (-1)
+
+// Busy-wait loops of the firmware spin here, so every turn advances the clock
+void tight_loop_contents(void);
+
+#endif //PILL_TEST_PICO_STDLIB_H
@@ -0,0 +1,20 @@
+#ifndef PILL_TEST_PICO_SYNC_H
+#define PILL_TEST_PICO_SYNC_H
+
+#include "pico/types.h"
+
+// The tests are single threaded: IRQ handlers run from sim_advance() between
+// statements of the code under test, never inside a critical section
+typedef struct { int unused; } critical_section_t;
+typedef struct { int unused; } mutex_t;
+
+static inline void critical_section_init(critical_section_t *c) { (void)c; }
+static inline void critical_section_enter_blocking(critical_section_t *c) { (void)c; }
+static inline void critical_section_exit(critical_section_t *c) { (void)c; }
+
+static inline void mutex_init(mutex_t *m) { (void)m; }
+static inline void mutex_enter_blocking(mutex_t *m) { (void)m; }
+static inline bool mutex_try_enter(mutex_t *m, uint32_t *owner) { (void)m; (void)owner; return true; }
+static inline void mutex_exit(mutex_t *m) { (void)m; }
+
+#endif //PILL_TEST_PICO_SYNC_H
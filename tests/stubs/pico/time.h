@@ -0,0 +1,27 @@
+#ifndef PILL_TEST_PICO_TIME_H
+#define PILL_TEST_PICO_TIME_H
+
+#include "pico/types.h"
+
+// Backed by the simulated clock in sim.c: time only moves when the code
+// under test spins in tight_loop_contents() or the test calls sim_advance()
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t id);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+// No events to wait for: one tick per call, true once the timeout is reached
+bool best_effort_wfe_or_timeout(absolute_time_t timeout);
+
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) { return t + ms * 1000ull; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return time_us_64() + ms * 1000ull; }
+static inline bool time_reached(absolute_time_t t) { return time_us_64() >= t; }
+
+#endif //PILL_TEST_PICO_TIME_H
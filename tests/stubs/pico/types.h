@@ -0,0 +1,30 @@
+#ifndef PILL_TEST_PICO_TYPES_H
+#define PILL_TEST_PICO_TYPES_H
+
+// Host stand-ins for the few Pico SDK types and macros the firmware uses.
+// Only what the files under test need; nothing here touches hardware.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+typedef struct {
+    int16_t year;
+    int8_t  month;
+    int8_t  day;
+    int8_t  dotw;
+    int8_t  hour;
+    int8_t  min;
+    int8_t  sec;
+} datetime_t;
+
+#define __not_in_flash(group)
+#define __not_in_flash_func(func) func
+#define __force_inline inline
+
+typedef volatile uint32_t io_rw_32;
+typedef volatile uint32_t io_ro_32;
+
+#endif //PILL_TEST_PICO_TYPES_H
@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "pico/stdlib.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/rtc.h"
+#include "hardware/structs/timer.h"
+
+#define SIM_ALARMS 16
+
+typedef struct {
+    alarm_id_t id;          // 0 = free
+    uint64_t due;
+    alarm_callback_t cb;
+    void *user_data;
+} sim_alarm_t;
+
+static uint64_t now_us;
+static alarm_id_t next_id;
+static sim_alarm_t alarms[SIM_ALARMS];
+static void (*hook)(void);
+static irq_handler_t irq_handlers[SIM_NUM_IRQS];
+static bool irq_enabled[SIM_NUM_IRQS];
+static bool gpio_level[NUM_BANK0_GPIOS];
+static timer_hw_t sim_timer_hw;
+timer_hw_t *const timer_hw = &sim_timer_hw;
+
+int sim_failures;
+
+static void sync_timer_hw(void) {
+    sim_timer_hw.timerawh = (uint32_t)(now_us >> 32);
+    sim_timer_hw.timerawl = (uint32_t)now_us;
+}
+
+void sim_reset(void) {
+    now_us  = 0;
+    next_id = 1;
+    sync_timer_hw();
+    memset(alarms, 0, sizeof(alarms));
+    hook = NULL;
+    for (uint i = 0; i < NUM_BANK0_GPIOS; i++) {
+        gpio_level[i] = true;   // everything the firmware reads is pulled up
+    }
+}
+
+uint64_t sim_now(void) {
+    return now_us;
+}
+
+void sim_set_hook(void (*h)(void)) {
+    hook = h;
+}
+
+// Earliest due alarm, NULL if none is due yet
+static sim_alarm_t *due_alarm(void) {
+    sim_alarm_t *best = NULL;
+    for (int i = 0; i < SIM_ALARMS; i++) {
+        sim_alarm_t *a = &alarms[i];
+        if (a->id && a->due <= now_us && (!best || a->due < best->due)) {
+            best = a;
+        }
+    }
+    return best;
+}
+
+// Return value as in the SDK: <0 = again that long after the scheduled
+// time, >0 = that long after now, 0 = done
+static void fire_alarms(void) {
+    sim_alarm_t *a;
+    while ((a = due_alarm()) != NULL) {
+        alarm_id_t id = a->id;
+        int64_t r = a->cb(id, a->user_data);
+        if (a->id != id) {
+            continue;       // cancelled from inside the callback
+        }
+        if (r < 0) {
+            a->due += (uint64_t)(-r);
+        } else if (r > 0) {
+            a->due = now_us + (uint64_t)r;
+        } else {
+            a->id = 0;
+        }
+    }
+}
+
+void sim_advance(uint64_t us) {
+    while (us--) {
+        now_us++;
+        sync_timer_hw();
+        fire_alarms();
+        if (hook) {
+            hook();
+        }
+    }
+}
+
+void sim_irq(uint num) {
+    if (num < SIM_NUM_IRQS && irq_enabled[num] && irq_handlers[num]) {
+        irq_handlers[num]();
+    }
+}
+
+void sim_gpio_set(uint gpio, bool level) {
+    if (gpio < NUM_BANK0_GPIOS) {
+        gpio_level[gpio] = level;
+    }
+}
+
+// ---- pico/time.h, pico/stdlib.h ----
+
+uint64_t time_us_64(void) {
+    return now_us;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)now_us;
+}
+
+void tight_loop_contents(void) {
+    sim_advance(1);
+}
+
+void sleep_us(uint64_t us) {
+    sim_advance(us);
+}
+
+void sleep_ms(uint32_t ms) {
+    sim_advance(ms * 1000ull);
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout) {
+    sim_advance(1);
+    return time_reached(timeout);
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    (void)fire_if_past;
+    for (int i = 0; i < SIM_ALARMS; i++) {
+        if (!alarms[i].id) {
+            alarms[i].id        = next_id++;
+            alarms[i].due       = now_us + us;
+            alarms[i].cb        = callback;
+            alarms[i].user_data = user_data;
+            return alarms[i].id;
+        }
+    }
+    return -1;
+}
+
+bool cancel_alarm(alarm_id_t id) {
+    for (int i = 0; i < SIM_ALARMS; i++) {
+        if (id > 0 && alarms[i].id == id) {
+            alarms[i].id = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---- hardware/irq.h ----
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    if (num < SIM_NUM_IRQS) {
+        irq_handlers[num] = handler;
+    }
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    if (num < SIM_NUM_IRQS) {
+        irq_enabled[num] = enabled;
+    }
+}
+
+// ---- hardware/gpio.h ----
+
+void gpio_init(uint gpio) { (void)gpio; }
+void gpio_set_dir(uint gpio, bool out) { (void)gpio; (void)out; }
+void gpio_pull_up(uint gpio) { (void)gpio; }
+void gpio_set_function(uint gpio, enum gpio_function fn) { (void)gpio; (void)fn; }
+void gpio_put(uint gpio, bool value) { (void)gpio; (void)value; }
+
+bool gpio_get(uint gpio) {
+    return gpio < NUM_BANK0_GPIOS ? gpio_level[gpio] : false;
+}
+
+// ---- hardware/rtc.h ----
+
+bool rtc_get_datetime(datetime_t *t) {
+    uint64_t s = now_us / 1000000u;
+    memset(t, 0, sizeof(*t));
+    t->year  = 2025;
+    t->month = 12;
+    t->day   = (int8_t)(7 + s / 86400u % 24u);   // good for the first few weeks
+    t->hour  = (int8_t)(s / 3600u % 24u);
+    t->min   = (int8_t)(s / 60u % 60u);
+    t->sec   = (int8_t)(s % 60u);
+    return true;
+}
+
+// ---- hardware/dma.h ----
+
+static dma_hw_t sim_dma_hw;
+dma_hw_t *const dma_hw = &sim_dma_hw;
+sim_dma_channel_t sim_dma[SIM_DMA_CHANNELS];
+void (*sim_dma_started)(uint channel);
+
+int dma_claim_unused_channel(bool required) {
+    for (int ch = 0; ch < SIM_DMA_CHANNELS; ch++) {
+        if (!sim_dma[ch].claimed) {
+            sim_dma[ch].claimed = true;
+            return ch;
+        }
+    }
+    if (required) {
+        printf("sim: no DMA channel left\n");
+    }
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = { .size = DMA_SIZE_32, .read_increment = true, .chain_to = channel };
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { c->size = size; }
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) { c->read_increment = incr; }
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) { c->write_increment = incr; }
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) { c->dreq = dreq; }
+void channel_config_set_chain_to(dma_channel_config *c, uint chain_to) { c->chain_to = chain_to; }
+void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff) { c->sniff = sniff; }
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    sim_dma_channel_t *d = &sim_dma[channel];
+    d->cfg        = *config;
+    d->write_addr = write_addr;
+    d->read_addr  = read_addr;
+    d->count      = transfer_count;
+    d->busy       = trigger;
+    if (trigger && sim_dma_started) {
+        sim_dma_started(channel);
+    }
+}
+
+void dma_channel_abort(uint channel) {
+    sim_dma[channel].busy = false;
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return sim_dma[channel].busy;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+    while (sim_dma[channel].busy) {
+        tight_loop_contents();
+    }
+}
+
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable) {
+    (void)channel;
+    (void)mode;
+    (void)force_channel_enable;
+}
+
+// ---- hardware/i2c.h, setup only; the bus itself is in sim_i2c.c ----
+
+struct i2c_inst { int unused; };
+i2c_inst_t sim_i2c0_inst;
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    (void)i2c;
+    return baudrate;
+}
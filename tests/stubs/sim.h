@@ -0,0 +1,30 @@
+#ifndef PILL_TEST_SIM_H
+#define PILL_TEST_SIM_H
+
+#include "pico/types.h"
+
+// Simulated clock for the host tests. One tick is one microsecond; every
+// tick fires the alarms that are due and then runs the peripheral hook.
+void sim_reset(void);
+uint64_t sim_now(void);
+void sim_advance(uint64_t us);
+
+// Peripheral model run after every tick (NULL = none)
+void sim_set_hook(void (*hook)(void));
+
+// Run the handler installed for irq, if it is enabled
+void sim_irq(uint num);
+
+// Input level returned by gpio_get()
+void sim_gpio_set(uint gpio, bool level);
+
+// Minimal check macro: report and count, the test exits non-zero at the end
+extern int sim_failures;
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            sim_failures++; \
+        } \
+    } while (0)
+
+#endif //PILL_TEST_SIM_H
@@ -0,0 +1,192 @@
+// eeprom_write()/eeprom_read() and the interrupt/DMA bus under them, against
+// a simulated 24LC256: page splitting, completion by ACK polling instead of
+// a fixed delay, the write-behind queue, and how lost writes are reported.
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_i2c.h"
+#include "eeprom.h"
+#include "eeprom_bus.h"
+
+// A page is on the chip once its bytes are clocked out, the write cycle is
+// over and the next ACK poll (poll interval plus one address byte) sees it
+#define PAGE_DONE_MAX_US(len) ((2 + 2 + (len)) * SIM_I2C_BYTE_US + SIM_EEPROM_TWC_US + \
+                               EEPROM_ACK_POLL_US + 2 * SIM_I2C_BYTE_US + 10)
+
+static void fill(uint8_t *buf, size_t len, uint8_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed + i * 7);
+    }
+}
+
+static void reset_chip(void) {
+    eeprom_flush();
+    sim_i2c_init();
+}
+
+static void test_single_page_timing(void) {
+    uint8_t data[LOG_ENTRY_SIZE];
+    uint8_t back[LOG_ENTRY_SIZE];
+    reset_chip();
+    fill(data, sizeof(data), 1);
+
+    uint64_t t0 = sim_now();
+    CHECK(eeprom_write(LOG_START_ADDR, data, sizeof(data)) == 0);
+    CHECK(sim_now() == t0);                        // queued, nothing waited for
+    CHECK(sim_eeprom.write_transactions == 0);
+
+    CHECK(eeprom_flush() == 0);
+    uint64_t took = sim_now() - t0;
+    printf("one %u byte page: %lu us\n", (unsigned)sizeof(data), (unsigned long)took);
+    CHECK(took >= SIM_EEPROM_TWC_US);
+    CHECK(took <= PAGE_DONE_MAX_US(sizeof(data)));
+    CHECK(took < 15000);                           // the old fixed sleep_ms(15)
+
+    CHECK(eeprom_read(LOG_START_ADDR, back, sizeof(back)) == 0);
+    CHECK(memcmp(data, back, sizeof(data)) == 0);
+}
+
+static void test_page_splitting(void) {
+    uint8_t data[200];
+    uint8_t back[200];
+    const uint16_t addr = EEPROM_PART_LOG_ADDR + 2 * EEPROM_PAGE_SIZE + 40;
+    reset_chip();
+    fill(data, sizeof(data), 3);
+
+    uint64_t t0 = sim_now();
+    CHECK(eeprom_write(addr, data, sizeof(data)) == 0);
+    CHECK(eeprom_flush() == 0);
+    uint64_t took = sim_now() - t0;
+
+    // 24 + 64 + 64 + 48 bytes, one page each, nothing wrapped inside a page
+    CHECK(sim_eeprom.write_transactions == 4);
+    CHECK(sim_eeprom.page_overruns == 0);
+    for (int p = 0; p < 4; p++) {
+        CHECK(sim_eeprom.page_writes[addr / EEPROM_PAGE_SIZE + p] == 1);
+    }
+    printf("200 bytes over 4 pages: %lu us\n", (unsigned long)took);
+    CHECK(took <= 4 * PAGE_DONE_MAX_US(EEPROM_PAGE_SIZE));
+
+    CHECK(eeprom_read(addr, back, sizeof(back)) == 0);
+    CHECK(memcmp(data, back, sizeof(data)) == 0);
+    CHECK(sim_eeprom.mem[addr - 1] == 0xFF);
+    CHECK(sim_eeprom.mem[addr + sizeof(data)] == 0xFF);
+}
+
+// More pages than the queue holds: eeprom_write() waits for room, not for the chip
+static void test_queue_back_pressure(void) {
+    static uint8_t data[1000];
+    static uint8_t back[1000];
+    reset_chip();
+    fill(data, sizeof(data), 5);
+
+    CHECK(eeprom_write(EEPROM_PART_LOG_ADDR, data, sizeof(data)) == 0);
+    CHECK(sim_eeprom.write_transactions <= 16 - EEPROM_WRITE_QUEUE_LEN);
+    CHECK(eeprom_flush() == 0);
+    CHECK(sim_eeprom.write_transactions == 16);
+    CHECK(sim_eeprom.page_overruns == 0);
+    CHECK(eeprom_read(EEPROM_PART_LOG_ADDR, back, sizeof(back)) == 0);
+    CHECK(memcmp(data, back, sizeof(data)) == 0);
+}
+
+static void test_read_after_queued_write(void) {
+    uint8_t data[32];
+    uint8_t back[32];
+    reset_chip();
+    fill(data, sizeof(data), 9);
+
+    CHECK(eeprom_write(CONFIG_ADDR, data, sizeof(data)) == 0);
+    CHECK(eeprom_read(CONFIG_ADDR, back, sizeof(back)) == 0);   // drains the queue first
+    CHECK(memcmp(data, back, sizeof(data)) == 0);
+}
+
+static void test_lost_write_reported(void) {
+    uint8_t data[LOG_ENTRY_SIZE];
+    reset_chip();
+    fill(data, sizeof(data), 11);
+
+    uint32_t failures = eeprom_write_failures();
+    sim_eeprom.dead = true;
+    CHECK(eeprom_write(LOG_START_ADDR, data, sizeof(data)) == 0);   // queued fine
+    CHECK(eeprom_flush() == -1);
+    CHECK(eeprom_write_failures() == failures + 1);
+    CHECK(eeprom_write_sync(LOG_START_ADDR, data, sizeof(data)) == -1);
+    CHECK(eeprom_write_failures() == failures + 2);
+
+    sim_eeprom.dead = false;
+    CHECK(eeprom_flush() == -1);   // a sync write leaves the latched error to eeprom_flush()
+    CHECK(eeprom_flush() == 0);
+    CHECK(eeprom_write_sync(LOG_START_ADDR, data, sizeof(data)) == 0);
+    CHECK(eeprom_write_failures() == failures + 2);
+}
+
+// The address NACK of a long read lands while DMA is still feeding read
+// commands. Nothing may follow it onto the bus, and the bus is usable after.
+static void test_read_late_nack(void) {
+    static uint8_t data[256];
+    static uint8_t back[256];
+    reset_chip();
+    fill(data, sizeof(data), 13);
+    CHECK(eeprom_write(EEPROM_PART_LOG_ADDR, data, sizeof(data)) == 0);
+    CHECK(eeprom_flush() == 0);
+
+    uint32_t failures = eeprom_write_failures();
+    uint32_t starts = sim_eeprom.transactions;
+    uint32_t nacks  = sim_eeprom.nacks;
+    sim_eeprom.dead = true;
+    CHECK(eeprom_read(EEPROM_PART_LOG_ADDR, back, sizeof(back)) == -1);
+    sleep_ms(10);                                  // a stray command would go out by now
+    CHECK(sim_eeprom.transactions == starts + 1);
+    CHECK(sim_eeprom.nacks == nacks + 1);
+    sim_eeprom.dead = false;
+
+    fill(data, sizeof(data), 17);
+    CHECK(eeprom_write(EEPROM_PART_LOG_ADDR, data, sizeof(data)) == 0);
+    CHECK(eeprom_flush() == 0);
+    CHECK(eeprom_write_failures() == failures);
+    CHECK(eeprom_read(EEPROM_PART_LOG_ADDR, back, sizeof(back)) == 0);
+    CHECK(memcmp(data, back, sizeof(data)) == 0);
+}
+
+// A record the chip never took keeps its seq, the next record reuses the slot
+static void test_write_log_retries_lost_record(void) {
+    log_record_t rec;
+    log_record_t back;
+    reset_chip();
+    CHECK(log_init() == 0);
+    CHECK(log_next_seq() == 0);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.event = LOG_EV_DISPENSE_OK;
+    write_log(&rec);
+    CHECK(log_next_seq() == 1);
+
+    sim_eeprom.dead = true;
+    rec.event = LOG_EV_DISPENSE_FAIL;
+    write_log(&rec);
+    CHECK(log_next_seq() == 1);
+    sim_eeprom.dead = false;
+
+    rec.event = LOG_EV_CYCLE_COMPLETE;
+    write_log(&rec);
+    CHECK(log_next_seq() == 2);
+    CHECK(eeprom_read(LOG_START_ADDR + LOG_ENTRY_SIZE, (uint8_t*)&back, sizeof(back)) == 0);
+    CHECK(log_record_valid(&back, 1) && back.seq == 1 && back.event == LOG_EV_CYCLE_COMPLETE);
+}
+
+int main(void) {
+    sim_reset();
+    sim_i2c_init();
+    setup_i2c();
+
+    test_single_page_timing();
+    test_page_splitting();
+    test_queue_back_pressure();
+    test_read_after_queued_write();
+    test_lost_write_reported();
+    test_read_late_nack();
+    test_write_log_retries_lost_record();
+
+    printf("%s\n", sim_failures ? "FAILED" : "OK");
+    return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+// Write cycles per EEPROM page over a simulated year of back-to-back pill
+// cycles at PILL_TIME, the worst case the FSM can produce. The state journal,
+// log, index and lifetime stats are driven through eeprom.c in the order the
+// FSM uses them, on a RAM bus that counts the write cycles of every page.
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "fake_eeprom_bus.h"
+#include "eeprom.h"
+#include "log_index.h"
+#include "stepper.h"
+
+#define ENDURANCE_CYCLES 1000000u   // 24LC256 datasheet, per page
+#define YEAR_S           (365u * 24 * 3600)
+
+typedef struct {
+    uint32_t max;
+    uint32_t min;
+    uint64_t total;
+} wear_t;
+
+static Stepper   motor;
+static Dispenser dis;
+static uint32_t  now_s;
+static uint32_t  cycles;
+
+static wear_t wear_of(uint32_t addr, uint32_t size) {
+    wear_t w = { 0, UINT32_MAX, 0 };
+    for (uint32_t p = addr / EEPROM_PAGE_SIZE; p < (addr + size) / EEPROM_PAGE_SIZE; p++) {
+        uint32_t n = fake_eeprom_page_writes[p];
+        if (n > w.max) w.max = n;
+        if (n < w.min) w.min = n;
+        w.total += n;
+    }
+    return w;
+}
+
+static void log_ev(log_event_id_t event) {
+    log_record_t rec = {0};
+    rec.time       = now_s;
+    rec.event      = (uint8_t)event;
+    rec.pills_left = (uint8_t)dis.pills_left;
+    rec.state      = (uint8_t)dis.state;
+    rec.day        = dis.slot_done;
+    write_log(&rec);
+}
+
+// Steps done at the first position checkpoint of a slot move, as
+// start_checkpointed() picks it
+static int first_checkpoint(int checkpoint_steps) {
+    return HALF_STEPS < 2 * checkpoint_steps ? HALF_STEPS / 2 : checkpoint_steps;
+}
+
+// One slot move and pill check, as ST_DISPENSING and stepper.c do it
+static void dispense(int checkpoint_steps) {
+    state_begin();
+    motor.target    = (motor.position + HALF_STEPS) % motor.steps_per_rev;
+    motor.in_motion = true;
+    save_sm_state(&dis);
+    state_flush();                                   // stepper_start_one_slot()
+    int at = motor.position;
+    for (int done = first_checkpoint(checkpoint_steps); done < HALF_STEPS; done += checkpoint_steps) {
+        motor.position = (at + done) % motor.steps_per_rev;
+        state_checkpoint(&dis);                      // stepper_poll()
+        CHECK(state_wait() == 0);
+    }
+    motor.position  = motor.target;
+    motor.in_motion = false;
+    save_sm_state(&dis);                             // stepper_finish_slot()
+    dis.pills_left--;
+    dis.slot_done++;
+    log_ev(LOG_EV_DISPENSE_OK);
+    stats_add(STAT_PILLS_OK);
+    save_sm_state(&dis);
+    state_commit();
+    now_s += PILL_TIME / 1000;
+}
+
+static void cycle(int checkpoint_steps) {
+    dis.state = ST_CALIBRATION;
+    motor.calibrated = true;
+    save_sm_state(&dis);
+    log_ev(LOG_EV_CALIBRATION_DONE);
+    dis.state = ST_DISPENSING;
+    save_sm_state(&dis);
+    for (int i = 0; i < PILL_NUMS; i++) {
+        dispense(checkpoint_steps);
+    }
+    log_ev(LOG_EV_DISPENSING_FINISH);
+    log_ev(LOG_EV_CYCLE_COMPLETE);
+    stats_add(STAT_CYCLES);
+    stats_save();
+    cycles++;
+    dis.state      = ST_WAIT_CALIBRATION;
+    dis.pills_left = PILL_NUMS;
+    dis.slot_done  = 0;
+    motor.calibrated = false;
+    save_sm_state(&dis);
+}
+
+// One year on a blank chip; write_log() chatter goes to /dev/null
+static void simulate_year(int checkpoint_steps) {
+    fake_eeprom_reset();
+    memset(&motor, 0, sizeof(motor));
+    memset(&dis, 0, sizeof(dis));
+    motor.steps_per_rev = HALF_STEPS * WHEEL_SLOTS;
+    dis.motor      = &motor;
+    dis.pills_left = PILL_NUMS;
+    now_s  = 0;
+    cycles = 0;
+    CHECK(log_init() == 0);
+    CHECK(stats_init() == 0);
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    CHECK(freopen("/dev/null", "w", stdout) != NULL);
+    while (now_s < YEAR_S) {
+        cycle(checkpoint_steps);
+    }
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+static void report(const char *name, wear_t w, bool leveled) {
+    printf("  %-7s max %7lu min %7lu page writes/year, %5.1f years to %u%s\n", name,
+           (unsigned long)w.max, (unsigned long)w.min,
+           w.max ? (double)ENDURANCE_CYCLES / w.max : 0.0, ENDURANCE_CYCLES,
+           leveled ? "" : " (unleveled)");
+}
+
+int main(void) {
+    sim_reset();
+    setup_i2c();
+
+    simulate_year(POS_CHECKPOINT_STEPS);
+    wear_t state = wear_of(EEPROM_PART_STATE_ADDR, EEPROM_PART_STATE_SIZE);
+    wear_t index = wear_of(EEPROM_PART_INDEX_ADDR, LOG_INDEX_BLOCKS * LOG_INDEX_SLOT_SIZE);
+    wear_t log   = wear_of(EEPROM_PART_LOG_ADDR, EEPROM_PART_LOG_SIZE);
+    wear_t stats = wear_of(EEPROM_PART_STATS_ADDR, EEPROM_PART_STATS_SIZE);
+    wear_t other = wear_of(EEPROM_PART_CONFIG_ADDR, EEPROM_PART_CONFIG_SIZE);
+    uint32_t per_dispense = 2 + 1 + (HALF_STEPS - 1 - first_checkpoint(POS_CHECKPOINT_STEPS)) / POS_CHECKPOINT_STEPS;
+
+    printf("one year at %u s per pill, checkpoint every %d half-steps (%lu state records per pill):\n",
+           PILL_TIME / 1000, POS_CHECKPOINT_STEPS, (unsigned long)per_dispense);
+    report("state", state, true);
+    report("log", log, true);
+    report("index", index, true);
+    report("stats", stats, true);
+    // one fixed slot would take every state record
+    report("state", (wear_t){ (uint32_t)state.total, (uint32_t)state.total, state.total }, false);
+
+    CHECK(state.max < ENDURANCE_CYCLES);
+    CHECK(log.max < ENDURANCE_CYCLES);
+    CHECK(index.max < ENDURANCE_CYCLES);
+    CHECK(stats.max < ENDURANCE_CYCLES);
+    CHECK(other.max == 0);                        // config untouched
+    // the rings spread evenly: pages differ by at most the slots they hold
+    CHECK(state.max - state.min <= EEPROM_PAGE_SIZE / STATE_SLOT_SIZE);
+    CHECK(log.max - log.min <= EEPROM_PAGE_SIZE / LOG_ENTRY_SIZE);
+    CHECK(index.max - index.min <= EEPROM_PAGE_SIZE / LOG_INDEX_SLOT_SIZE);
+    CHECK(stats.max - stats.min <= EEPROM_PAGE_SIZE / STATS_SLOT_SIZE);
+
+    // The journal after a year still restores the last state
+    simple_state_t s;
+    CHECK(load_state(&s) == 0);
+    CHECK(s.state == ST_WAIT_CALIBRATION && s.pills_left == PILL_NUMS && !s.in_motion);
+    // and the stats of every cycle, plus the boot that reads them
+    CHECK(stats_init() == 0);
+    CHECK(stats_get(STAT_CYCLES) == cycles);
+    CHECK(stats_get(STAT_PILLS_OK) == cycles * PILL_NUMS);
+    CHECK(stats_get(STAT_BOOTS) == 2);
+
+    // The former 48 half-step checkpoint rate, for comparison
+    simulate_year(48);
+    wear_t fast = wear_of(EEPROM_PART_STATE_ADDR, EEPROM_PART_STATE_SIZE);
+    printf("checkpoint every 48 half-steps:\n");
+    report("state", fast, true);
+    CHECK(state.max * 3 < fast.max);
+
+    printf("%s\n", sim_failures ? "FAILED" : "OK");
+    return sim_failures ? 1 : 0;
+}
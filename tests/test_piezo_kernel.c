@@ -0,0 +1,160 @@
+// The piezo impact classifier on synthetic traces at the ADC rate: one pill,
+// two pills landing apart and together, traces with no pill at all, and
+// motor vibration before the pill lands.
+// Traces are fed in PIEZO_BLOCK chunks, as the DMA IRQ does.
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include "sim.h"
+#include "piezo_adc.h"
+
+#define TRACE_SAMPLES  20000     // 400 ms, the longest detection window
+#define BASELINE       2048
+#define RING_PERIOD    20        // samples, 2.5 kHz ringing of the tray
+#define RING_TAU       400.0     // samples, 8 ms decay
+#define PILL_AMPLITUDE 900.0
+#define VIBRATION_PERIOD    50   // samples, one half-step at cruise
+#define VIBRATION_AMPLITUDE 150.0   // motor hum, below PIEZO_IMPACT_THRESH
+#define MS(ms)         ((ms) * 1000 / PIEZO_SAMPLE_US)
+
+static double trace[TRACE_SAMPLES];
+static int arrival;              // sample the wheel reaches the hole at, -1 = before the trace
+static uint32_t rng = 12345;
+
+// Uniform noise in [-amp, amp]
+static double noise(int amp) {
+    rng = rng * 1664525u + 1013904223u;
+    return (double)((int)(rng >> 16) % (2 * amp + 1) - amp);
+}
+
+static void clear_trace(int noise_amp) {
+    arrival = -1;
+    for (int i = 0; i < TRACE_SAMPLES; i++) {
+        trace[i] = BASELINE + noise(noise_amp);
+    }
+}
+
+// Decaying ringing of one impact starting at sample `at`
+static void add_impact(int at, double amplitude) {
+    for (int i = at; i < TRACE_SAMPLES; i++) {
+        double t = i - at;
+        trace[i] += amplitude * exp(-t / RING_TAU) * sin(2.0 * M_PI * t / RING_PERIOD);
+    }
+}
+
+// Motor vibration up to sample `to`
+static void add_vibration(int to, double amplitude) {
+    for (int i = 0; i < to; i++) {
+        trace[i] += amplitude * sin(2.0 * M_PI * i / VIBRATION_PERIOD);
+    }
+}
+
+// Run the kernel over the trace block by block, marking the arrival before
+// the block it falls in; *first_onset = sample of the first onset
+// reported, -1 if none
+static piezo_class_t classify(piezo_kernel_t *k, int *first_onset) {
+    uint16_t block[PIEZO_BLOCK];
+    piezo_kernel_reset(k);
+    *first_onset = -1;
+    for (int at = 0; at + PIEZO_BLOCK <= TRACE_SAMPLES; at += PIEZO_BLOCK) {
+        for (int i = 0; i < PIEZO_BLOCK; i++) {
+            double v = trace[at + i];
+            block[i] = (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v);
+        }
+        if (arrival >= at && arrival < at + PIEZO_BLOCK) {
+            piezo_kernel_arrive(k);
+        }
+        piezo_kernel_feed(k, block, PIEZO_BLOCK);
+        if (k->onset >= 0 && *first_onset < 0) {
+            *first_onset = at + k->onset;
+        }
+    }
+    return piezo_kernel_result(k);
+}
+
+static piezo_class_t run(const char *name, int *first_onset) {
+    piezo_kernel_t k;
+    piezo_class_t c = classify(&k, first_onset);
+    printf("%-20s class %d, %u impacts, energy %8lu, peak %4u\n", name, c, k.impacts,
+           (unsigned long)k.energy, k.peak);
+    return c;
+}
+
+static void test_one_pill(void) {
+    int onset;
+    clear_trace(20);
+    add_impact(MS(50), PILL_AMPLITUDE);
+    CHECK(run("one pill", &onset) == PIEZO_ONE);
+    CHECK(onset >= MS(50) && onset < MS(50) + RING_PERIOD);
+
+    // a lighter pill late in the window
+    clear_trace(20);
+    add_impact(MS(300), PILL_AMPLITUDE / 2);
+    CHECK(run("one light pill", &onset) == PIEZO_ONE);
+}
+
+static void test_two_pills(void) {
+    int onset;
+    clear_trace(20);
+    add_impact(MS(50), PILL_AMPLITUDE);
+    add_impact(MS(110), PILL_AMPLITUDE);
+    CHECK(run("two pills 60 ms", &onset) == PIEZO_MULTI);
+    CHECK(onset >= MS(50) && onset < MS(50) + RING_PERIOD);
+
+    // the second lands in the ringing of the first: one onset, twice the energy
+    clear_trace(20);
+    add_impact(MS(50), PILL_AMPLITUDE);
+    add_impact(MS(52), PILL_AMPLITUDE);
+    CHECK(run("two pills together", &onset) == PIEZO_MULTI);
+}
+
+static void test_noise(void) {
+    int onset;
+    clear_trace(40);
+    CHECK(run("noise", &onset) == PIEZO_NONE);
+    CHECK(onset < 0);
+
+    // slow drift is tracked by the baseline
+    clear_trace(20);
+    for (int i = 0; i < TRACE_SAMPLES; i++) {
+        trace[i] += 300.0 * i / TRACE_SAMPLES;
+    }
+    CHECK(run("drift", &onset) == PIEZO_NONE);
+
+    // a knock on the case below the impact threshold
+    clear_trace(20);
+    add_impact(MS(100), PIEZO_IMPACT_THRESH * 0.8);
+    CHECK(run("knock", &onset) == PIEZO_NONE);
+}
+
+// The capture starts with the move, so the motor hums into the kernel
+// before the pill lands
+static void test_motor_vibration(void) {
+    int onset;
+    clear_trace(20);
+    add_vibration(MS(250), VIBRATION_AMPLITUDE);
+    add_impact(MS(300), PILL_AMPLITUDE);
+    CHECK(run("vibration, no reset", &onset) == PIEZO_MULTI);   // the hum alone adds a pill
+    arrival = MS(250);
+    CHECK(run("vibration, one pill", &onset) == PIEZO_ONE);
+    CHECK(onset >= MS(300) && onset < MS(300) + RING_PERIOD);
+
+    // a pill landing during the last steps keeps its energy at the arrival
+    clear_trace(20);
+    add_vibration(MS(250), VIBRATION_AMPLITUDE);
+    add_impact(MS(240), PILL_AMPLITUDE);
+    add_impact(MS(242), PILL_AMPLITUDE);
+    arrival = MS(250);
+    CHECK(run("two pills at arrival", &onset) == PIEZO_MULTI);
+    CHECK(onset >= MS(240) && onset < MS(240) + RING_PERIOD);
+}
+
+int main(void) {
+    test_one_pill();
+    test_two_pills();
+    test_noise();
+    test_motor_vibration();
+
+    printf("%s\n", sim_failures ? "FAILED" : "OK");
+    return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+// The pill sensor on the simulated clock: an alarm raises the piezo edge a
+// chosen latency after the wheel reached the hole, as the comparator would.
+// Covers the detection window adapting to where the pills really land,
+// both narrower and, once the pills land later, wider again.
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "hardware/gpio.h"
+#include "fake_gpio_irq.h"
+#include "pill_sensor.h"
+
+#define PILL_GAP_US 100000   // between two dispenses, long past any listen
+
+static pillSensorState sensor;
+
+// Edge mode only: the ADC capture is never started
+static piezo_kernel_t kernel;
+void piezo_adc_init(piezo_impact_cb cb, void *ctx) { (void)cb; (void)ctx; }
+void piezo_adc_start(void) {}
+void piezo_adc_stop(void) {}
+void piezo_adc_arrive(void) {}
+piezo_class_t piezo_adc_result(void) { return PIEZO_NONE; }
+const piezo_kernel_t *piezo_adc_kernel(void) { return &kernel; }
+
+static int64_t pill_lands(alarm_id_t id, void *user_data) {
+    (void)id;
+    (void)user_data;
+    fake_gpio_irq_edge(PILL_SENSOR_PIN, GPIO_IRQ_EDGE_FALL);
+    return 0;
+}
+
+// A slot move ends now and a pill lands `latency_ms` later (-1 = empty
+// slot). Returns the verdict, *waited_ms = time spent in pill_sensor_wait()
+static bool dispense(int latency_ms, uint32_t *waited_ms) {
+    pill_sensor_reset(&sensor);
+    uint64_t hole = sim_now();
+    if (latency_ms >= 0) {
+        CHECK(add_alarm_in_us((uint64_t)latency_ms * 1000, pill_lands, NULL, true) > 0);
+    }
+    pill_sensor_arm(&sensor, hole);
+    bool hit = pill_sensor_wait(&sensor);
+    if (waited_ms) {
+        *waited_ms = (uint32_t)((sim_now() - hole) / 1000);
+    }
+    sim_advance(PILL_GAP_US);
+    return hit;
+}
+
+// Spread over `spread` ms from `base`, the same sequence every run
+static int latency(int base, int spread, int i) {
+    return base + (i * 7) % spread;
+}
+
+static void test_empty_slot(void) {
+    uint32_t total = sensor.hist_total;
+    uint32_t waited = 0;
+    CHECK(!dispense(-1, &waited));
+    // listened on past the window, and an empty slot is no latency sample
+    CHECK(waited >= PILL_LISTEN_MS && waited <= PILL_LISTEN_MS + 1);
+    CHECK(sensor.hist_total == total);
+    CHECK(sensor.pill_fall_time == sensor.formula_time);
+}
+
+static void test_window_shrinks(void) {
+    for (int i = 0; i < 40; i++) {
+        uint32_t waited = 0;
+        CHECK(dispense(latency(50, 20, i), &waited));
+        CHECK(waited == (uint32_t)latency(50, 20, i));   // the edge ends the wait
+    }
+    printf("pills at 50-69 ms: window %lu ms (formula %lu ms)\n",
+           (unsigned long)sensor.pill_fall_time, (unsigned long)sensor.formula_time);
+    CHECK(sensor.pill_fall_time < sensor.formula_time);
+    CHECK(sensor.pill_fall_time >= 70 + PILL_ADAPT_MARGIN_MS);
+    CHECK(sensor.late_hits == 0);
+}
+
+// The tray or the pills change and they land later than the shrunk window.
+// They still count, and the window follows them out.
+static void test_window_grows(void) {
+    uint32_t narrow = sensor.pill_fall_time;
+    CHECK(narrow < 160);
+    for (int i = 0; i < 40; i++) {
+        CHECK(dispense(latency(160, 30, i), NULL));
+    }
+    printf("pills at 160-189 ms: window %lu ms, %lu late\n",
+           (unsigned long)sensor.pill_fall_time, (unsigned long)sensor.late_hits);
+    CHECK(sensor.late_hits > 0 && sensor.late_hits < 40);
+    CHECK(sensor.pill_fall_time >= 190 + PILL_ADAPT_MARGIN_MS);
+    CHECK(sensor.pill_fall_time <= PILL_WINDOW_MAX_MS);
+
+    // once it covers them, they are no longer late
+    uint32_t late = sensor.late_hits;
+    for (int i = 0; i < 10; i++) {
+        CHECK(dispense(latency(160, 30, i), NULL));
+    }
+    CHECK(sensor.late_hits == late);
+}
+
+int main(void) {
+    sim_reset();
+    memset(&sensor, 0, sizeof(sensor));
+    pill_sensor_init(&sensor);
+
+    test_empty_slot();
+    test_window_shrinks();
+    test_window_grows();
+
+    printf("%s\n", sim_failures ? "FAILED" : "OK");
+    return sim_failures ? 1 : 0;
+}
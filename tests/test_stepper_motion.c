@@ -0,0 +1,253 @@
+// The alarm-driven motion engine on the simulated clock: step count and
+// timing, the ramp, coil current levels, stop conditions and index tracking.
+// A tick hook plays the opto fork, raising index_hit when the counted
+// position reaches the edge.
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "fake_coil.h"
+#include "stepper_motion.h"
+
+#define SENSOR_PIN 28
+
+static Stepper motor;
+
+static int edge_at = -1;           // counted position of the index edge, -1 = no edge
+static int sensor_low_after = -1;  // steps after which the sensor level changes, -1 = never
+static int last_position;
+
+static void wheel_hook(void) {
+    if (motor.position != last_position) {
+        last_position = motor.position;
+        if (motor.position == edge_at) {
+            motor.index_hit = true;
+        }
+    }
+    if (sensor_low_after >= 0 && motion_steps_done() >= sensor_low_after) {
+        sim_gpio_set(SENSOR_PIN, false);
+    }
+}
+
+static void setup(int steps_per_rev, int position) {
+    memset(&motor, 0, sizeof(motor));
+    motor.sensor_pin    = SENSOR_PIN;
+    motor.steps_per_rev = steps_per_rev;
+    motor.position      = position;
+    last_position       = position;
+    edge_at             = -1;
+    sensor_low_after    = -1;
+    sim_gpio_set(SENSOR_PIN, true);
+    motion_take_slip(NULL);
+    fake_coil_clear();
+}
+
+// Start a move and run the clock until it ends; returns the steps taken
+static int32_t run(int dir, int32_t steps, uint32_t flags, bool *stopped) {
+    CHECK(motion_start(&motor, dir, steps, flags, NULL, NULL) == 0);
+    CHECK(motion_start(&motor, dir, steps, flags, NULL, NULL) == -1);   // one move at a time
+    return motion_wait(stopped);
+}
+
+// Coil events that were steps: everything but the final hold
+static int step_events(void) {
+    CHECK(fake_coil_events > 0 && fake_coil_events <= FAKE_COIL_LOG);
+    CHECK(fake_coil_log[fake_coil_events - 1].level == COIL_HOLD);
+    return fake_coil_events - 1;
+}
+
+static uint32_t interval(int i) {
+    return (uint32_t)(fake_coil_log[i].t_us - fake_coil_log[i - 1].t_us);
+}
+
+static void test_unramped(void) {
+    setup(0, 0);
+    motor.step_index = 6;
+    uint64_t t0 = sim_now();
+    bool stopped = true;
+    CHECK(run(+1, 20, 0, &stopped) == 20);
+    CHECK(!stopped);
+
+    int n = step_events();
+    CHECK(n == 20);
+    CHECK(fake_coil_log[0].t_us - t0 == MOTION_STEP_PERIOD_US);
+    for (int i = 0; i < n; i++) {
+        CHECK(fake_coil_log[i].phase == (6 + 1 + i) % 8);
+        CHECK(fake_coil_log[i].level == (i < MOTION_BOOST_STEPS ? COIL_BOOST : COIL_RUN));
+        if (i > 0) {
+            CHECK(interval(i) == MOTION_STEP_PERIOD_US);
+        }
+    }
+    // the last step gets a full period before the hold
+    CHECK(interval(n) == MOTION_STEP_PERIOD_US);
+    CHECK(fake_coil_log[n].phase == fake_coil_log[n - 1].phase);
+    CHECK(motor.step_index == (6 + 20) % 8);
+
+    setup(0, 0);
+    CHECK(run(-1, 5, 0, NULL) == 5);
+    CHECK(fake_coil_log[0].phase == 7 && fake_coil_log[4].phase == 3);
+}
+
+static void test_ramp(int32_t steps) {
+    setup(0, 0);
+    CHECK(run(+1, steps, MOTION_RAMP, NULL) == steps);
+    int n = step_events();
+    CHECK(n == steps);
+
+    uint32_t fastest = MOTION_STEP_PERIOD_US;
+    for (int i = 1; i < n; i++) {
+        uint32_t p = interval(i);
+        CHECK(p >= MOTION_MIN_PERIOD_US && p < MOTION_STEP_PERIOD_US);
+        CHECK(p == interval(n - i));                          // symmetric profile
+        if (i < n / 2) {
+            CHECK(p <= interval(i > 1 ? i - 1 : 1));          // speeding up
+            // boost while accelerating, run current once at cruise
+            bool accelerating = interval(i > 1 ? i - 1 : 1) > MOTION_MIN_PERIOD_US;
+            CHECK(fake_coil_log[i - 1].level == (accelerating ? COIL_BOOST : COIL_RUN));
+        }
+        if (p < fastest) fastest = p;
+    }
+    printf("ramp %d steps: %lu us total, fastest period %lu us\n", (int)steps,
+           (unsigned long)(fake_coil_log[n - 1].t_us - fake_coil_log[0].t_us), (unsigned long)fastest);
+    if (steps >= 300) {
+        CHECK(fastest == MOTION_MIN_PERIOD_US);               // trapezoid reaches cruise
+        CHECK(fake_coil_log[n / 2].level == COIL_RUN);
+    } else {
+        CHECK(fastest > MOTION_MIN_PERIOD_US);                // triangle never does
+    }
+}
+
+static void test_stop_on_index(void) {
+    setup(0, 0);
+    edge_at = 37;
+    bool stopped = false;
+    CHECK(run(+1, 1000, MOTION_STOP_INDEX, &stopped) == 37);
+    CHECK(stopped);
+    CHECK(!motor.index_hit);                 // the stop consumed the flag
+    CHECK(step_events() == 37);
+
+    // a stale flag from before the move is cleared at the start
+    setup(0, 0);
+    motor.index_hit = true;
+    CHECK(run(+1, 10, MOTION_STOP_INDEX, &stopped) == 10);
+    CHECK(!stopped);
+}
+
+static void test_stop_on_sensor(void) {
+    setup(0, 0);
+    sensor_low_after = 20;
+    bool stopped = false;
+    CHECK(run(+1, 1000, MOTION_STOP_SENSOR, &stopped) == 20);
+    CHECK(stopped);
+
+    // the level at the start is the reference, a low sensor stops when it goes high
+    setup(0, 0);
+    sim_gpio_set(SENSOR_PIN, false);
+    CHECK(run(+1, 30, MOTION_STOP_SENSOR, &stopped) == 30);
+    CHECK(!stopped);
+}
+
+// CW move across the index of a 4096 step wheel, edge at counted position
+// `edge` (-1 = none). Every case must still end on counted position 104.
+static void track_case(int edge, int32_t expect_done, motion_slip_t expect_slip, int32_t expect_error) {
+    setup(4096, 4000);
+    edge_at = edge;
+    uint32_t passes = motion_index_stats()->passes;
+    CHECK(run(+1, 200, MOTION_TRACK_INDEX, NULL) == expect_done);
+    int32_t error = 0;
+    CHECK(motion_take_slip(&error) == expect_slip);
+    CHECK(error == expect_error);
+    if (expect_slip != MOTION_SLIP_LOST) {
+        CHECK(motor.position == 104);
+        CHECK(motion_index_stats()->passes == passes + 1);
+        CHECK(motion_index_stats()->last_error == (edge > 2048 ? edge - 4096 : edge));
+    }
+}
+
+static void test_track_index(void) {
+    track_case(0,    200, MOTION_SLIP_NONE,      0);    // on the count
+    track_case(3,    203, MOTION_SLIP_NONE,      0);    // wheel 3 behind, corrected silently
+    track_case(4094, 198, MOTION_SLIP_NONE,      0);    // wheel 2 ahead
+    track_case(10,   210, MOTION_SLIP_CORRECTED, 10);   // beyond MOTION_DRIFT_MAX
+    track_case(-1,   200, MOTION_SLIP_LOST,      0);    // no edge in the window
+    CHECK(motion_take_slip(NULL) == MOTION_SLIP_NONE);  // taking the slip clears it
+}
+
+// Time from the first step to the last of a ramped move, fastest period
+static uint32_t ramped_travel(int32_t steps, uint32_t mode, uint32_t *fastest) {
+    setup(0, 0);
+    CHECK(run(+1, steps, MOTION_RAMP | mode, NULL) == steps);
+    int n = step_events();
+    *fastest = MOTION_STEP_PERIOD_US;
+    for (int i = 1; i < n; i++) {
+        if (interval(i) < *fastest) *fastest = interval(i);
+    }
+    return (uint32_t)(fake_coil_log[n - 1].t_us - fake_coil_log[0].t_us);
+}
+
+static void test_full_steps(void) {
+    setup(0, 0);
+    CHECK(run(+1, 100, MOTION_MODE_FULL, NULL) == 100);
+    int n = step_events();
+    // one half-step onto an odd phase, full steps, then the fine approach
+    int full = (100 - 1 - MOTION_FINE_STEPS + 1) / 2;
+    CHECK(n == 1 + full + (100 - 1 - 2 * full));
+    CHECK(fake_coil_log[0].phase == 1);
+    for (int i = 1; i <= full; i++) {
+        CHECK(fake_coil_log[i].phase % 2 == 1);                         // two phases on
+        // unramped full steps keep the wheel at the start speed
+        CHECK(interval(i) == (i == 1 ? MOTION_STEP_PERIOD_US : 2 * MOTION_STEP_PERIOD_US));
+    }
+    for (int i = full + 2; i < n; i++) {
+        CHECK(interval(i) == MOTION_STEP_PERIOD_US);
+    }
+    CHECK(motor.step_index == 100 % 8);
+
+    // Ramped, full steps cruise at twice the half-step speed: half a
+    // revolution takes clearly less time, a slot-to-slot move still gains
+    uint32_t fastest_half, fastest_full;
+    uint32_t half_rev = ramped_travel(HALF_STEPS * WHEEL_SLOTS / 2, 0, &fastest_half);
+    uint32_t full_rev = ramped_travel(HALF_STEPS * WHEEL_SLOTS / 2, MOTION_MODE_FULL, &fastest_full);
+    CHECK(fastest_half == MOTION_MIN_PERIOD_US);
+    CHECK(fastest_full == MOTION_FULL_MIN_PERIOD_US);
+    uint32_t half_slot = ramped_travel(HALF_STEPS, 0, &fastest_half);
+    uint32_t full_slot = ramped_travel(HALF_STEPS, MOTION_MODE_FULL, &fastest_full);
+    printf("full steps: %.2fx the half-step speed over half a revolution, %.2fx slot to slot\n",
+           (double)half_rev / full_rev, (double)half_slot / full_slot);
+    CHECK(full_rev * 10 < half_rev * 6);
+    CHECK(full_slot * 10 < half_slot * 8);
+
+    // wave steps reach the same cruise on the gentler ramp
+    uint32_t fastest_wave;
+    uint32_t wave_rev = ramped_travel(HALF_STEPS * WHEEL_SLOTS / 2, MOTION_MODE_WAVE, &fastest_wave);
+    CHECK(fastest_wave == MOTION_FULL_MIN_PERIOD_US);
+    CHECK(wave_rev > full_rev && wave_rev < half_rev);
+}
+
+static void test_stop_request(void) {
+    setup(0, 0);
+    CHECK(motion_start(&motor, +1, 1000, 0, NULL, NULL) == 0);
+    sim_advance(10 * MOTION_STEP_PERIOD_US + 1);
+    motion_stop();
+    bool stopped = true;
+    CHECK(motion_wait(&stopped) == 10);
+    CHECK(!stopped);                         // a request is not a stop condition
+}
+
+int main(void) {
+    sim_reset();
+    sim_set_hook(wheel_hook);
+    setup(0, 0);
+    motion_init(&motor);
+
+    test_unramped();
+    test_ramp(300);
+    test_ramp(60);
+    test_stop_on_index();
+    test_stop_on_sensor();
+    test_track_index();
+    test_full_steps();
+    test_stop_request();
+
+    printf("%s\n", sim_failures ? "FAILED" : "OK");
+    return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Decode a binary log export (log_export.c) from the pill dispenser.
+
+    python3 tools/log_decode.py capture.bin
+    python3 tools/log_decode.py /dev/ttyUSB0 --serial [--offset HEX]
+
+With --serial the export is requested with the "X" service command, which
+the device serves in any state, between log writes and uplinks. Frames with
+a bad CRC are dropped and reported with the offset to resume from.
+"""
+import argparse
+import datetime
+import struct
+import sys
+import time
+
+SYNC = b"\xA5\x5A"
+
+EVENTS = [
+    "NONE",
+    "BOOT DONE LORA OK",
+    "BOOT DONE LORA FAIL",
+    "FRESH BOOT",
+    "POWER LOSS DURING MOVEMENT",
+    "MOTOR NOT CALIBRATED",
+    "RESUME DISPENSING",
+    "CALIBRATED FAIL",
+    "CALIBRATION DONE",
+    "DISPENSING FINISH",
+    "DISPENSE OK",
+    "DISPENSE FAIL NO PILLS",
+    "RECOVERY DONE",
+    "CYCLE COMPLETE",
+    "STEP SLIP CORRECTED",
+    "INDEX LOST RESYNC",
+    "DISPENSE MULTIPLE PILLS",
+]
+
+# log_record_t: seq, time, event, day, pills_left, state, arg, crc
+RECORD = struct.Struct("<IIBBBBHH")
+
+
+def crc16(data):
+    """CRC-16/CCITT as in crc16.c (poly 0x1021, init 0xFFFF)."""
+    crc = 0xFFFF
+    for b in data:
+        x = ((crc >> 8) ^ b) & 0xFF
+        x ^= x >> 4
+        crc = ((crc << 8) ^ (x << 12) ^ (x << 5) ^ x) & 0xFFFF
+    return crc
+
+
+def parse_frames(buf):
+    """Yield (type, offset, payload) for every frame with a good CRC, plus a bad count."""
+    frames, bad, i = [], 0, 0
+    while True:
+        i = buf.find(SYNC, i)
+        if i < 0 or i + 9 > len(buf):
+            break
+        ftype, offset, length = struct.unpack_from("<BIH", buf, i + 2)
+        end = i + 9 + length + 2
+        if end > len(buf):
+            break
+        body = buf[i + 2:i + 9 + length]
+        (crc,) = struct.unpack_from("<H", buf, i + 9 + length)
+        if crc16(body) == crc:
+            frames.append((chr(ftype), offset, buf[i + 9:i + 9 + length]))
+            i = end
+        else:
+            bad += 1
+            i += 1
+    return frames, bad
+
+
+def render(rec):
+    seq, ts, event, day, pills_left, state, arg, _ = rec
+    when = datetime.datetime.fromtimestamp(ts, datetime.timezone.utc).strftime("%Y-%m-%d %H:%M:%S")
+    name = EVENTS[event] if event < len(EVENTS) else "UNKNOWN(%d)" % event
+    text = "%s Day %u %s" % (when, day, name) if day else "%s %s" % (when, name)
+    return "Log %u: %s  [pills_left=%u state=%u arg=%u]" % (seq, text, pills_left, state, arg)
+
+
+def decode(buf):
+    frames, bad = parse_frames(buf)
+    header = next((f for f in frames if f[0] == "H"), None)
+    if header is None:
+        sys.exit("no export header found")
+    entry_size, max_entries, next_seq, area = struct.unpack("<HHII", header[2])
+
+    image = bytearray(area)
+    have = bytearray(area)
+    for ftype, offset, payload in frames:
+        if ftype == "D" and offset + len(payload) <= area:
+            image[offset:offset + len(payload)] = payload
+            have[offset:offset + len(payload)] = b"\x01" * len(payload)
+
+    records = []
+    for slot in range(max_entries):
+        off = slot * entry_size
+        if not all(have[off:off + entry_size]):
+            continue
+        raw = bytes(image[off:off + entry_size])
+        rec = RECORD.unpack(raw)
+        if crc16(raw[:RECORD.size - 2]) != rec[-1] or rec[0] % max_entries != slot:
+            continue  # empty or torn slot, keep going
+        if rec[0] >= next_seq:
+            continue  # stale data from before a reset
+        records.append(rec)
+
+    for rec in sorted(records, key=lambda r: r[0]):
+        print(render(rec))
+
+    missing = have.find(b"\x00", header[1])
+    print("# %d records, next seq %u, %d bad frames" % (len(records), next_seq, bad), file=sys.stderr)
+    if missing >= 0:
+        print("# incomplete, resume with: X%X" % missing, file=sys.stderr)
+
+
+def read_serial(port, offset):
+    import serial  # pyserial, only needed for live capture
+
+    with serial.Serial(port, 115200, timeout=1) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"X%X\n" % offset)
+        buf, idle = bytearray(), 0
+        while idle < 3:
+            chunk = ser.read(4096)
+            buf += chunk
+            idle = 0 if chunk else idle + 1
+        return bytes(buf)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("source", help="capture file, or serial port with --serial")
+    ap.add_argument("--serial", action="store_true", help="request the export from a live device")
+    ap.add_argument("--offset", type=lambda v: int(v, 16), default=0, help="resume offset (hex)")
+    args = ap.parse_args()
+
+    if args.serial:
+        start = time.time()
+        buf = read_serial(args.source, args.offset)
+        print("# %d bytes in %.1f s" % (len(buf), time.time() - start), file=sys.stderr)
+    else:
+        with open(args.source, "rb") as f:
+            buf = f.read()
+    decode(buf)
+
+
+if __name__ == "__main__":
+    main()